@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DamageQueue.h"
+#include "SurvivalGameCharacter.h"
+#include "StatStore.h"
+#include "Stat.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "Math/RandomStream.h"
+
+FDamageQueue& FDamageQueue::Get()
+{
+	check(IsInGameThread());
+
+	static FDamageQueue Queue;
+	return Queue;
+}
+
+int32 FDamageQueue::FindOrAddCharacter(ASurvivalGameCharacter* character)
+{
+	if (character == nullptr)
+		return INDEX_NONE;
+
+	int32* index = characterIndexes.Find(character);
+
+	if (index != nullptr)
+		return *index;
+
+	return characterIndexes.Add(character, characters.Add(character));
+}
+
+void FDamageQueue::Add(ASurvivalGameCharacter* target, ASurvivalGameCharacter* instigator, float amount, bool heals, EArmourType damageType)
+{
+	if (target == nullptr)
+		return;
+
+	hits.Add({ FindOrAddCharacter(target), FindOrAddCharacter(instigator), amount, damageType, heals });
+}
+
+void FDamageQueue::SortHits(const TArray<FDamageHit>& unsorted, TArray<uint64>& keys, TArray<FDamageHit>& outSorted)
+{
+	// Target in the high half and queue position in the low half, so a plain sort is stable
+	keys.SetNumUninitialized(unsorted.Num(), false);
+
+	for (int32 i = 0; i < unsorted.Num(); i++) {
+		keys[i] = ((uint64)(uint32)unsorted[i].target << 32) | (uint32)i;
+	}
+
+	Algo::Sort(keys);
+
+	outSorted.SetNumUninitialized(unsorted.Num(), false);
+
+	for (int32 i = 0; i < keys.Num(); i++) {
+		outSorted[i] = unsorted[(uint32)keys[i]];
+	}
+}
+
+void FDamageQueue::ResolveTarget(const FDamageHit* targetHits, FDamageTarget& target)
+{
+	float startHealth = target.health;
+	float health = startHealth;
+
+	for (int32 i = 0; i < target.numHits; i++) {
+		// A dead target drops the rest of its hits, in place of the IsAlive check made when they were queued
+		if (health <= 0)
+			break;
+
+		const FDamageHit& hit = targetHits[i];
+		float change = hit.heals ? hit.amount : -hit.amount * target.damageMultipliers[(uint8)hit.damageType];
+
+		// Min applied before max, the same as FStatStore::SetCurrent
+		health = FMath::Min(FMath::Max(health + change, target.minimum), target.maximum);
+
+		if (health <= 0)
+			target.killer = hit.instigator;
+	}
+
+	target.health = health;
+	target.died = startHealth > 0 && health <= 0;
+}
+
+void FDamageQueue::ResolveTargets(const TArray<FDamageHit>& sorted, TArray<FDamageTarget>& outTargets, bool parallel)
+{
+	int32 numTasks = FMath::DivideAndRoundUp(outTargets.Num(), TargetsPerTask);
+
+	// Every target only reads its own hits and writes itself
+	ParallelFor(numTasks, [&sorted, &outTargets](int32 task) {
+		int32 last = FMath::Min((task + 1) * TargetsPerTask, outTargets.Num());
+
+		for (int32 i = task * TargetsPerTask; i < last; i++) {
+			ResolveTarget(sorted.GetData() + outTargets[i].firstHit, outTargets[i]);
+		}
+	}, !parallel || numTasks < 2);
+}
+
+void FDamageQueue::Resolve(bool parallel)
+{
+	if (hits.Num() == 0)
+		return;
+
+	// Swapped out so anything queued while applying goes into the next frame
+	Exchange(hits, resolvingHits);
+	Exchange(characters, resolvingCharacters);
+	hits.Reset();
+	characters.Reset();
+	characterIndexes.Reset();
+
+	SortHits(resolvingHits, sortKeys, sortedHits);
+
+	FStatStore& store = FStatStore::Get();
+	targets.Reset();
+
+	for (int32 first = 0; first < sortedHits.Num();) {
+		int32 character = sortedHits[first].target;
+		int32 last = first + 1;
+
+		while (last < sortedHits.Num() && sortedHits[last].target == character) {
+			last++;
+		}
+
+		ASurvivalGameCharacter* targetCharacter = resolvingCharacters[character].Get();
+
+		// Characters without health can't be hurt
+		if (targetCharacter != nullptr && targetCharacter->GetHealthStat() != nullptr) {
+			int32 slot = targetCharacter->GetStatSlot();
+
+			FDamageTarget& target = targets.AddDefaulted_GetRef();
+			target.character = character;
+			target.firstHit = first;
+			target.numHits = last - first;
+			target.health = store.GetCurrent(FStatStore::Health, slot);
+			target.minimum = store.GetMin(FStatStore::Health, slot);
+			target.maximum = store.GetMax(FStatStore::Health, slot);
+			target.killer = INDEX_NONE;
+			target.died = false;
+
+			for (int32 i = 0; i < 4; i++) {
+				target.damageMultipliers[i] = targetCharacter->GetDamageMultiplier((EArmourType)i);
+			}
+		}
+
+		first = last;
+	}
+
+	ResolveTargets(sortedHits, targets, parallel);
+
+	for (const FDamageTarget& target : targets) {
+		resolvingCharacters[target.character]->SetCurrentHealth(target.health);
+	}
+
+	for (const FDamageTarget& target : targets) {
+		if (!target.died)
+			continue;
+
+		// Listeners may destroy characters, so both are looked up again
+		ASurvivalGameCharacter* victim = resolvingCharacters[target.character].Get();
+		ASurvivalGameCharacter* killer = target.killer != INDEX_NONE ? resolvingCharacters[target.killer].Get() : nullptr;
+
+		if (victim != nullptr)
+			killedEvent.Broadcast(victim, killer);
+	}
+
+	resolvingHits.Reset();
+	resolvingCharacters.Reset();
+}
+
+double FDamageQueue::BenchmarkResolve(int32 numTargets, int32 numHits, bool parallel)
+{
+	FRandomStream random(12345);
+	TArray<FDamageHit> benchmarkHits;
+	benchmarkHits.SetNumUninitialized(numHits);
+
+	for (FDamageHit& hit : benchmarkHits) {
+		hit.target = random.RandHelper(numTargets);
+		hit.instigator = random.RandHelper(numTargets);
+		hit.amount = random.FRandRange(1, 20);
+		hit.damageType = (EArmourType)random.RandHelper(4);
+		hit.heals = random.RandHelper(10) == 0;
+	}
+
+	TArray<uint64> keys;
+	TArray<FDamageHit> sorted;
+	TArray<FDamageTarget> benchmarkTargets;
+	benchmarkTargets.Reserve(numTargets);
+
+	double start = FPlatformTime::Seconds();
+
+	SortHits(benchmarkHits, keys, sorted);
+
+	for (int32 first = 0; first < sorted.Num();) {
+		int32 last = first + 1;
+
+		while (last < sorted.Num() && sorted[last].target == sorted[first].target) {
+			last++;
+		}
+
+		FDamageTarget& target = benchmarkTargets.AddDefaulted_GetRef();
+		target.character = sorted[first].target;
+		target.firstHit = first;
+		target.numHits = last - first;
+		target.health = 1000;
+		target.minimum = 0;
+		target.maximum = 1000;
+		target.killer = INDEX_NONE;
+		target.died = false;
+
+		for (int32 i = 0; i < 4; i++) {
+			target.damageMultipliers[i] = 100 / (100 + 25.0f * i);
+		}
+
+		first = last;
+	}
+
+	ResolveTargets(sorted, benchmarkTargets, parallel);
+
+	double seconds = FPlatformTime::Seconds() - start;
+
+	// Counted so the resolve can't be optimised away
+	int32 deaths = 0;
+
+	for (const FDamageTarget& target : benchmarkTargets) {
+		deaths += target.died ? 1 : 0;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Damage: %d hits on %d targets in %.3f ms (%d deaths)"), numHits, numTargets, seconds * 1000.0, deaths);
+
+	return seconds > 0 ? numHits / (seconds * 1000.0) : 0;
+}
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Datatables/DataTables.h"
+
+class ASurvivalGameCharacter;
+
+// killer is nullptr when the hit had no instigator or the instigator has since been destroyed
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnCharacterKilled, ASurvivalGameCharacter* /* victim */, ASurvivalGameCharacter* /* killer */);
+
+/**
+ * Hits queued during the frame and resolved together by UStatSubsystem, before stat changes are delivered.
+ * Hits are sorted by target, so each target's health and resistances are read once and its health written once,
+ * however many hits it took. A target's hits are applied in the order they were queued, which keeps the result
+ * the same whether or not targets are resolved in parallel. Once a target is dead its remaining hits, heals included,
+ * are dropped. Kill events fire after every target has been applied.
+ * Game thread only.
+ */
+class SURVIVALGAME_API FDamageQueue
+{
+public:
+	static FDamageQueue& Get();
+
+	// Targets per ParallelFor task
+	static const int32 TargetsPerTask = 256;
+
+	// amount is before armour, and always positive, heals decides which way it goes
+	void Add(ASurvivalGameCharacter* target, ASurvivalGameCharacter* instigator, float amount, bool heals, EArmourType damageType);
+	int32 Num() const { return hits.Num(); }
+
+	// Applies every queued hit. Hits queued by kill listeners are left for the next call
+	void Resolve(bool parallel = false);
+
+	FOnCharacterKilled& OnKilled() { return killedEvent; }
+
+	// Hits resolved per millisecond against synthetic targets, covering the sort and the resolve but not writing to actors
+	static double BenchmarkResolve(int32 numTargets = 1000, int32 numHits = 1000000, bool parallel = true);
+
+private:
+	FDamageQueue() {}
+
+	struct FDamageHit
+	{
+		// Both index characters, instigator is INDEX_NONE for none
+		int32 target;
+		int32 instigator;
+		float amount;
+		EArmourType damageType;
+		bool heals;
+	};
+
+	struct FDamageTarget
+	{
+		int32 character;
+		int32 firstHit;
+		int32 numHits;
+		float health;
+		float minimum;
+		float maximum;
+		float damageMultipliers[4];
+
+		// Set by resolving, killer is the instigator of the hit that took health to zero
+		int32 killer;
+		bool died;
+	};
+
+	TArray<FDamageHit> hits;
+	TArray<TWeakObjectPtr<ASurvivalGameCharacter>> characters;
+	TMap<ASurvivalGameCharacter*, int32> characterIndexes;
+
+	// Reused between frames
+	TArray<FDamageHit> resolvingHits;
+	TArray<TWeakObjectPtr<ASurvivalGameCharacter>> resolvingCharacters;
+	TArray<uint64> sortKeys;
+	TArray<FDamageHit> sortedHits;
+	TArray<FDamageTarget> targets;
+
+	FOnCharacterKilled killedEvent;
+
+	int32 FindOrAddCharacter(ASurvivalGameCharacter* character);
+
+	// Stable sort by target, hits on the same target keep their queue order
+	static void SortHits(const TArray<FDamageHit>& unsorted, TArray<uint64>& keys, TArray<FDamageHit>& outSorted);
+	static void ResolveTarget(const FDamageHit* targetHits, FDamageTarget& target);
+	static void ResolveTargets(const TArray<FDamageHit>& sorted, TArray<FDamageTarget>& outTargets, bool parallel);
+};
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BakeSpecPackCommandlet.h"
+#include "DataTables.h"
+#include "SpecPack.h"
+
+int32 UBakeSpecPackCommandlet::Main(const FString& Params)
+{
+	FString outputPath = UDataTables::GetDefaultSpecPackPath();
+	FParse::Value(*Params, TEXT("Output="), outputPath);
+
+	UDataTables* dataTables = UDataTables::GetInstance();
+	dataTables->LoadTables();
+
+	if (!FSpecPack::Bake(dataTables, outputPath)) {
+		UE_LOG(LogTemp, Error, TEXT("Failed to write spec pack to %s"), *outputPath);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Baked spec pack to %s"), *outputPath);
+	return 0;
+}
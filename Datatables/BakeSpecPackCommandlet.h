@@ -0,0 +1,19 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "BakeSpecPackCommandlet.generated.h"
+
+/**
+ * Cook step for the spec pack, run with -run=BakeSpecPack [-Output=<path>]
+ */
+UCLASS()
+class SURVIVALGAME_API UBakeSpecPackCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	virtual int32 Main(const FString& Params) override;
+};
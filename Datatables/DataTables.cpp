@@ -2,103 +2,679 @@
 
 
 #include "DataTables.h"
+#include "SpecPack.h"
+#include "Algo/StableSort.h"
+#include "Misc/Paths.h"
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "Containers/Ticker.h"
 
 UDataTables* UDataTables::INSTANCE;
+TAtomic<const FSpecDatabase*> UDataTables::PUBLISHED_SPECS(nullptr);
+TAtomic<int32> UDataTables::ACQUIRING_READERS(0);
 
-UDataTables::UDataTables()
+namespace SpecTablePaths
+{
+	const TCHAR* Items = TEXT("CompositeDataTable'/Game/TopDownCPP/Datatables/ItemTable.ItemTable'");
+	const TCHAR* Weapons = TEXT("DataTable'/Game/TopDownCPP/Datatables/WeaponsTable.WeaponsTable'");
+	const TCHAR* Loadouts = TEXT("DataTable'/Game/TopDownCPP/Datatables/Loadouts.Loadouts'");
+	const TCHAR* Loot = TEXT("DataTable'/Game/TopDownCPP/Datatables/LootTable.LootTable'");
+	const TCHAR* Armour = TEXT("DataTable'/Game/TopDownCPP/Datatables/Armour.Armour'");
+	const TCHAR* ArmourValues = TEXT("DataTable'/Game/TopDownCPP/Datatables/ArmourValues.ArmourValues'");
+	const TCHAR* HeatWeapons = TEXT("DataTable'/Game/TopDownCPP/Datatables/HeatWeapons.HeatWeapons'");
+	const TCHAR* AmmoWeapons = TEXT("DataTable'/Game/TopDownCPP/Datatables/AmmoWeapons.AmmoWeapons'");
+}
+
+FSpecDatabase::FSpecDatabase()
+	: itemIndex(MakeShared<FItemIndex, ESPMode::ThreadSafe>())
+	, weaponIndex(MakeShared<FWeaponIndex, ESPMode::ThreadSafe>())
+	, heatWeaponIndex(MakeShared<TWeaponPartIndex<FHeatWeaponSpecification>, ESPMode::ThreadSafe>())
+	, ammoWeaponIndex(MakeShared<TWeaponPartIndex<FAmmoWeaponSpecification>, ESPMode::ThreadSafe>())
+	, archetypeIndex(MakeShared<FArchetypeIndex, ESPMode::ThreadSafe>())
+	, armourIndex(MakeShared<FArmourIndex, ESPMode::ThreadSafe>())
+	, armourValueIndex(MakeShared<FArmourValueIndex, ESPMode::ThreadSafe>())
+	, loadoutRows(MakeShared<TRowList<FLoadout>, ESPMode::ThreadSafe>())
+	, lootRows(MakeShared<TRowList<FLootEntry>, ESPMode::ThreadSafe>())
+{
+}
+
+const FItemSpecification* FSpecDatabase::GetItemSpecification(FItemId itemID) const
 {
-	/*static ConstructorHelpers::FObjectFinder<UDataTable>
-		itemTable_BP(TEXT("CompositeDataTable'/Game/TopDownCPP/Datatables/ItemTable.ItemTable'"));
+	const FItemSpecification* const* itemSpec = itemIndex->byItemID.Find(itemID);
+	return itemSpec != nullptr ? *itemSpec : nullptr;
+}
 
-	SetItemTable(itemTable_BP.Object);
+const FWeaponSpecification* FSpecDatabase::GetWeaponSpecification(FItemId itemID) const
+{
+	const FWeaponSpecification* const* weaponSpec = weaponIndex->byItemID.Find(itemID);
+	return weaponSpec != nullptr ? *weaponSpec : nullptr;
+}
 
-	static ConstructorHelpers::FObjectFinder<UDataTable>
-		weaponTable_BP(TEXT("DataTable'/Game/TopDownCPP/Datatables/WeaponsTable.WeaponsTable'"));
+FWeaponSpecId FSpecDatabase::GetWeaponSpecificationID(FItemId itemID) const
+{
+	const FWeaponSpecId* weaponID = weaponIndex->weaponIDsByItemID.Find(itemID);
+	return weaponID != nullptr ? *weaponID : FWeaponSpecId();
+}
 
-	SetWeaponTable(weaponTable_BP.Object);
+const FHeatWeaponSpecification* FSpecDatabase::GetHeatWeaponSpecification(FWeaponSpecId weaponSpecificationID) const
+{
+	const FHeatWeaponSpecification* const* heatSpec = heatWeaponIndex->byWeaponID.Find(weaponSpecificationID);
+	return heatSpec != nullptr ? *heatSpec : nullptr;
+}
 
-	static ConstructorHelpers::FObjectFinder<UDataTable>
-		loadoutTable_BP(TEXT("DataTable'/Game/TopDownCPP/Datatables/Loadouts.Loadouts'"));
+const FAmmoWeaponSpecification* FSpecDatabase::GetAmmoWeaponSpecification(FWeaponSpecId weaponSpecificationID) const
+{
+	const FAmmoWeaponSpecification* const* ammoSpec = ammoWeaponIndex->byWeaponID.Find(weaponSpecificationID);
+	return ammoSpec != nullptr ? *ammoSpec : nullptr;
+}
 
-	SetLoadoutTable(loadoutTable_BP.Object);
+const FArmourSpecification* FSpecDatabase::GetArmourSpecification(FItemId itemID) const
+{
+	const FArmourSpecification* const* armourSpec = armourIndex->byItemID.Find(itemID);
+	return armourSpec != nullptr ? *armourSpec : nullptr;
+}
 
-	static ConstructorHelpers::FObjectFinder<UDataTable>
-		armourTable_BP(TEXT("DataTable'/Game/TopDownCPP/Datatables/Armour.Armour'"));
+FArmourId FSpecDatabase::GetArmourID(FItemId itemID) const
+{
+	const FArmourId* armourID = armourIndex->armourIDsByItemID.Find(itemID);
+	return armourID != nullptr ? *armourID : FArmourId();
+}
 
-	SetArmourTable(armourTable_BP.Object);
+TArrayView<const FArmourValue* const> FSpecDatabase::GetArmourValuesForArmour(FArmourId armourID) const
+{
+	const FInt32Interval* span = armourValueIndex->spans.Find(armourID);
 
-	static ConstructorHelpers::FObjectFinder<UDataTable>
-		armourValuesTable_BP(TEXT("DataTable'/Game/TopDownCPP/Datatables/ArmourValues.ArmourValues'"));
+	if (span == nullptr)
+		return TArrayView<const FArmourValue* const>();
 
-	SetArmourValuesTable(armourValuesTable_BP.Object);
+	return TArrayView<const FArmourValue* const>(armourValueIndex->sorted.GetData() + span->Min, span->Max - span->Min);
+}
 
-	static ConstructorHelpers::FObjectFinder<UDataTable>
-		heatWeaponsTable_BP(TEXT("DataTable'/Game/TopDownCPP/Datatables/HeatWeapons.HeatWeapons'"));
+const FWeaponArchetype* FSpecDatabase::GetWeaponArchetype(FItemId itemID) const
+{
+	const int32* position = archetypeIndex->byItemID.Find(itemID);
+	return position != nullptr ? &archetypeIndex->archetypes[*position] : nullptr;
+}
 
-	SetHeatWeaponTable(heatWeaponsTable_BP.Object);
+UDataTables::UDataTables()
+{
+	// Tables are no longer found in the constructor, PreloadAsync loads them at boot instead
+	readyFuture = readyPromise.GetFuture().Share();
+}
 
-	static ConstructorHelpers::FObjectFinder<UDataTable>
-		ammoWeaponsTable_BP(TEXT("DataTable'/Game/TopDownCPP/Datatables/AmmoWeapons.AmmoWeapons'"));
+void UDataTables::BeginDestroy()
+{
+	if (this == INSTANCE) {
+		FTicker::GetCoreTicker().RemoveTicker(reclaimTicker);
+		PUBLISHED_SPECS = nullptr;
+		INSTANCE = nullptr;
+	}
 
-	SetAmmoWeaponTable(ammoWeaponsTable_BP.Object);*/
+	Super::BeginDestroy();
 }
 
 UDataTables* UDataTables::GetInstance()
 {
 	if (INSTANCE == nullptr)
 	{
+		check(IsInGameThread());
+
 		INSTANCE = NewObject<UDataTables>();
+		INSTANCE->AddToRoot();
+
+		// Dedicated servers start from the baked pack when one has been cooked
+		if (IsRunningDedicatedServer())
+			INSTANCE->LoadSpecPack(GetDefaultSpecPackPath());
 	}
 
 	return INSTANCE;
 }
 
-TArray<FItemSpecification*> UDataTables::GetItems()
+const FSpecDatabase* UDataTables::GetSpecs()
+{
+	static const FSpecDatabase EmptySpecs;
+
+	const FSpecDatabase* specs = PUBLISHED_SPECS.Load();
+	return specs != nullptr ? specs : &EmptySpecs;
+}
+
+FSpecDatabaseRef UDataTables::AcquireSpecs()
+{
+	static const FSpecDatabaseRef EmptySpecs = MakeShared<const FSpecDatabase, ESPMode::ThreadSafe>();
+
+	ACQUIRING_READERS++;
+
+	// The snapshot can't be freed until this reader is done, and AsShared only takes a reference
+	const FSpecDatabase* specs = PUBLISHED_SPECS.Load();
+	FSpecDatabaseRef acquired = specs != nullptr ? specs->AsShared() : EmptySpecs;
+
+	ACQUIRING_READERS--;
+	return acquired;
+}
+
+void UDataTables::LoadTables()
+{
+	SetItemTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Items).TryLoad()));
+	SetWeaponTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Weapons).TryLoad()));
+	SetLoadoutTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Loadouts).TryLoad()));
+	SetLootTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Loot).TryLoad()));
+	SetArmourTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Armour).TryLoad()));
+	SetArmourValuesTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::ArmourValues).TryLoad()));
+	SetHeatWeaponTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::HeatWeapons).TryLoad()));
+	SetAmmoWeaponTable(Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::AmmoWeapons).TryLoad()));
+
+	indexingStarted = true;
+	SetReady();
+	PublishReady();
+}
+
+TArray<FSoftObjectPath> UDataTables::GetTablePaths()
+{
+	return {
+		FSoftObjectPath(SpecTablePaths::Items),
+		FSoftObjectPath(SpecTablePaths::Weapons),
+		FSoftObjectPath(SpecTablePaths::Loadouts),
+		FSoftObjectPath(SpecTablePaths::Loot),
+		FSoftObjectPath(SpecTablePaths::Armour),
+		FSoftObjectPath(SpecTablePaths::ArmourValues),
+		FSoftObjectPath(SpecTablePaths::HeatWeapons),
+		FSoftObjectPath(SpecTablePaths::AmmoWeapons)
+	};
+}
+
+void UDataTables::PreloadAsync()
 {
-	TArray<FItemSpecification*> items;
-	GetItemTable()->GetAllRows<FItemSpecification>(TEXT("Test"), items);
-	return items;
+	check(IsInGameThread());
+
+	if (preloadHandle.IsValid() || IsReady())
+		return;
+
+	preloadHandle = streamableManager.RequestAsyncLoad(GetTablePaths(),
+		FStreamableDelegate::CreateUObject(this, &UDataTables::OnTablesLoaded));
+}
+
+void UDataTables::OnTablesLoaded()
+{
+	if (indexingStarted)
+		return;
+
+	indexingStarted = true;
+
+	itemTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Items).ResolveObject());
+	weaponTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Weapons).ResolveObject());
+	loadoutTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Loadouts).ResolveObject());
+	lootTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Loot).ResolveObject());
+	armourTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::Armour).ResolveObject());
+	armourValuesTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::ArmourValues).ResolveObject());
+	heatWeaponTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::HeatWeapons).ResolveObject());
+	ammoWeaponTable = Cast<UDataTable>(FSoftObjectPath(SpecTablePaths::AmmoWeapons).ResolveObject());
+
+	// Row gathering and indexing only read the loaded tables, so it can happen off the game thread.
+	// Publishing swaps the snapshots the game thread reads, so that waits for FinishIndexing
+	indexingTask = Async<void>(EAsyncExecution::ThreadPool, [this]() {
+		CacheRows(itemTable, EditPart(staging.itemIndex).rows);
+		CacheRows(weaponTable, EditPart(staging.weaponIndex).rows);
+		CacheRows(loadoutTable, EditPart(staging.loadoutRows).rows);
+		CacheRows(lootTable, EditPart(staging.lootRows).rows);
+		CacheRows(armourTable, EditPart(staging.armourIndex).rows);
+		CacheRows(armourValuesTable, EditPart(staging.armourValueIndex).rows);
+		CacheRows(heatWeaponTable, EditPart(staging.heatWeaponIndex).rows);
+		CacheRows(ammoWeaponTable, EditPart(staging.ammoWeaponIndex).rows);
+
+		IndexItems();
+		IndexWeapons();
+		IndexHeatWeapons();
+		IndexAmmoWeapons();
+		UpdateWeaponArchetypes();
+		IndexArmour();
+		IndexArmourValues();
+
+		AsyncTask(ENamedThreads::GameThread, [this]() {
+			FinishIndexing();
+		});
+	});
+}
+
+void UDataTables::FinishIndexing()
+{
+	check(IsInGameThread());
+
+	if (!indexingTask.IsValid())
+		return;
+
+	indexingTask.Wait();
+	indexingTask = TFuture<void>();
+
+	PublishSpecs();
+	SetReady();
+	PublishReady();
+}
+
+void UDataTables::PublishSpecs()
+{
+	check(IsInGameThread());
+
+	staging.generation++;
+
+	FPublishedSpecs published;
+	published.specs = MakeShared<const FSpecDatabase, ESPMode::ThreadSafe>(staging);
+	published.retiredFrame = 0;
+
+	for (UDataTable* table : { itemTable, weaponTable, heatWeaponTable, ammoWeaponTable, loadoutTable, lootTable, abilitiesTable, armourTable, armourValuesTable }) {
+		if (table != nullptr)
+			published.tables.AddUnique(table);
+	}
+
+	if (publishedSpecs.Num() > 0)
+		publishedSpecs.Last().retiredFrame = GFrameCounter;
+
+	publishedSpecs.Add(MoveTemp(published));
+
+	// Release store, readers that load the new pointer see a fully built snapshot
+	PUBLISHED_SPECS.Store(publishedSpecs.Last().specs.Get());
+
+	ReclaimSpecs();
+
+	if (publishedSpecs.Num() > 1 && !reclaimTicker.IsValid())
+		reclaimTicker = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UDataTables::TickReclaim));
 }
 
-TArray<FWeaponSpecification*> UDataTables::GetWeapons()
+void UDataTables::ReclaimSpecs()
 {
-	TArray<FWeaponSpecification*> weapons;
-	GetWeaponTable()->GetAllRows<FWeaponSpecification>(TEXT("Test"), weapons);
-	return weapons;
+	check(IsInGameThread());
+
+	// Raw GetSpecs pointers last until the end of the frame, acquired ones until released.
+	// A retired snapshot can't be acquired again once no reader is between loading and pinning it,
+	// so from then on, once it's unique only this list holds it
+	bool readersAcquiring = ACQUIRING_READERS.Load() != 0;
+
+	publishedSpecs.RemoveAll([readersAcquiring](const FPublishedSpecs& published) {
+		return !readersAcquiring && published.retiredFrame != 0 && GFrameCounter > published.retiredFrame && published.specs.IsUnique();
+	});
+
+	referencedTables.Reset();
+
+	for (const FPublishedSpecs& published : publishedSpecs) {
+		for (UDataTable* table : published.tables) {
+			referencedTables.AddUnique(table);
+		}
+	}
 }
 
-TArray<FHeatWeaponSpecification*> UDataTables::GetHeatWeapons()
+bool UDataTables::TickReclaim(float deltaTime)
 {
-	TArray<FHeatWeaponSpecification*> weapons;
-	GetHeatWeaponTable()->GetAllRows<FHeatWeaponSpecification>(TEXT("Test"), weapons);
-	return weapons;
+	ReclaimSpecs();
+
+	if (publishedSpecs.Num() > 1)
+		return true;
+
+	reclaimTicker.Reset();
+	return false;
 }
 
-TArray<FAmmoWeaponSpecification*> UDataTables::GetAmmoWeapons()
+void UDataTables::SetReady()
 {
-	TArray<FAmmoWeaponSpecification*> weapons;
-	GetAmmoWeaponTable()->GetAllRows<FAmmoWeaponSpecification>(TEXT("Test"), weapons);
-	return weapons;
+	if (!tablesReady.AtomicSet(true))
+		readyPromise.SetValue();
 }
 
-TArray<FArmourSpecification*> UDataTables::GetArmour()
+void UDataTables::PublishReady()
 {
-	TArray<FArmourSpecification*> armour;
-	GetArmourTable()->GetAllRows<FArmourSpecification>(TEXT("Test"), armour);
-	return armour;
+	if (readyPublished)
+		return;
+
+	readyPublished = true;
+
+	TArray<FSimpleDelegate> callbacks = MoveTemp(readyCallbacks);
+
+	for (FSimpleDelegate& callback : callbacks) {
+		callback.ExecuteIfBound();
+	}
 }
 
-TArray<FArmourValue*> UDataTables::GetArmourValues()
+void UDataTables::WhenReady(FSimpleDelegate callback)
 {
-	TArray<FArmourValue*> armourValues;
-	GetArmourValuesTable()->GetAllRows<FArmourValue>(TEXT("Test"), armourValues);
-	return armourValues;
+	if (readyPublished) {
+		callback.ExecuteIfBound();
+	}
+	else {
+		readyCallbacks.Add(callback);
+		PreloadAsync();
+	}
 }
 
-TArray<FLoadout*> UDataTables::GetLoadouts()
+void UDataTables::WaitUntilReady()
 {
-	TArray<FLoadout*> loadouts;
-	if (loadoutTable != nullptr)
-		GetLoadoutTable()->GetAllRows<FLoadout>(TEXT("Test"), loadouts);
-	return loadouts;
+	if (IsReady())
+		return;
+
+	if (IsInGameThread()) {
+		// Stalling a running world for the loads is a hitch, gameplay code should go through WhenReady
+		ensureMsgf(GWorld == nullptr || !GWorld->HasBegunPlay(), TEXT("WaitUntilReady blocked the game thread during play, use WhenReady"));
+
+		PreloadAsync();
+
+		// Finish the outstanding asset loads rather than waiting on a delegate this thread would have to run.
+		// There's no handle when RequestAsyncLoad had nothing to load
+		if (preloadHandle.IsValid())
+			preloadHandle->WaitUntilComplete();
+
+		OnTablesLoaded();
+
+		// The publish is queued for this thread, so wait on the indexing and publish here
+		FinishIndexing();
+		return;
+	}
+
+	readyFuture.Wait();
+}
+
+bool UDataTables::LoadSpecPack(const FString& path)
+{
+	check(IsInGameThread());
+
+	TUniquePtr<FSpecPack> specPack = FSpecPack::Mount(path);
+
+	if (!specPack.IsValid())
+		return false;
+
+	// The tables own copies of the rows, so the mapping can go once they are built
+	specPack->Unpack(this);
+
+	indexingStarted = true;
+	SetReady();
+	PublishReady();
+	return true;
+}
+
+FString UDataTables::GetDefaultSpecPackPath()
+{
+	return FPaths::Combine(FPaths::ProjectContentDir(), TEXT("Datatables"), TEXT("SpecPack.bin"));
+}
+
+void UDataTables::SetItemTable(UDataTable* val)
+{
+	FinishIndexing();
+	itemTable = val;
+	CacheRows(itemTable, EditPart(staging.itemIndex).rows);
+	IndexItems();
+	PublishSpecs();
+}
+
+void UDataTables::SetLoadoutTable(UDataTable* val)
+{
+	FinishIndexing();
+	loadoutTable = val;
+	CacheRows(loadoutTable, EditPart(staging.loadoutRows).rows);
+	PublishSpecs();
+}
+
+void UDataTables::SetLootTable(UDataTable* val)
+{
+	FinishIndexing();
+	lootTable = val;
+	CacheRows(lootTable, EditPart(staging.lootRows).rows);
+	PublishSpecs();
+}
+
+void UDataTables::SetAbilitiesTable(UDataTable* val)
+{
+	FinishIndexing();
+	abilitiesTable = val;
+	PublishSpecs();
+}
+
+void UDataTables::SetWeaponTable(UDataTable* val)
+{
+	FinishIndexing();
+	weaponTable = val;
+	CacheRows(weaponTable, EditPart(staging.weaponIndex).rows);
+	IndexWeapons();
+	UpdateWeaponArchetypes();
+	PublishSpecs();
+}
+
+void UDataTables::SetHeatWeaponTable(UDataTable* val)
+{
+	FinishIndexing();
+	heatWeaponTable = val;
+	CacheRows(heatWeaponTable, EditPart(staging.heatWeaponIndex).rows);
+	IndexHeatWeapons();
+	UpdateWeaponArchetypes();
+	PublishSpecs();
+}
+
+void UDataTables::SetAmmoWeaponTable(UDataTable* val)
+{
+	FinishIndexing();
+	ammoWeaponTable = val;
+	CacheRows(ammoWeaponTable, EditPart(staging.ammoWeaponIndex).rows);
+	IndexAmmoWeapons();
+	UpdateWeaponArchetypes();
+	PublishSpecs();
+}
+
+void UDataTables::SetArmourTable(UDataTable* val)
+{
+	FinishIndexing();
+	armourTable = val;
+	CacheRows(armourTable, EditPart(staging.armourIndex).rows);
+	IndexArmour();
+	PublishSpecs();
+}
+
+void UDataTables::SetArmourValuesTable(UDataTable* val)
+{
+	FinishIndexing();
+	armourValuesTable = val;
+	CacheRows(armourValuesTable, EditPart(staging.armourValueIndex).rows);
+	IndexArmourValues();
+	PublishSpecs();
+}
+
+// Item rows are named by their itemID
+void UDataTables::IndexItems()
+{
+	FSpecDatabase::FItemIndex& index = EditPart(staging.itemIndex);
+
+	PatchIndex(itemTable, itemRows,
+		[](FName rowName, uint8* row) { return FItemId::FromRowName(rowName); },
+		[&index](FItemId itemID, FName rowName, uint8* row) { index.byItemID.Add(itemID, reinterpret_cast<FItemSpecification*>(row)); },
+		[&index](FItemId itemID) { index.byItemID.Remove(itemID); });
+}
+
+// Weapon rows are named by their weapon specification ID, which heat and ammo rows refer back to
+void UDataTables::IndexWeapons()
+{
+	FSpecDatabase::FWeaponIndex& index = EditPart(staging.weaponIndex);
+
+	PatchIndex(weaponTable, weaponRows,
+		[](FName rowName, uint8* row) { return FItemId(reinterpret_cast<FWeaponSpecification*>(row)->itemSpecificationID); },
+		[this, &index](FItemId itemID, FName rowName, uint8* row) {
+			FWeaponSpecId weaponID = FWeaponSpecId::FromRowName(rowName);
+			index.byItemID.Add(itemID, reinterpret_cast<FWeaponSpecification*>(row));
+			index.weaponIDsByItemID.Add(itemID, weaponID);
+			index.itemIDsByWeaponID.Add(weaponID, itemID);
+			staleArchetypes.Add(itemID);
+		},
+		[this, &index](FItemId itemID) {
+			FWeaponSpecId weaponID;
+
+			if (index.weaponIDsByItemID.RemoveAndCopyValue(itemID, weaponID) && index.itemIDsByWeaponID.FindRef(weaponID) == itemID)
+				index.itemIDsByWeaponID.Remove(weaponID);
+
+			index.byItemID.Remove(itemID);
+			staleArchetypes.Add(itemID);
+		});
+}
+
+void UDataTables::IndexHeatWeapons()
+{
+	FSpecDatabase::TWeaponPartIndex<FHeatWeaponSpecification>& index = EditPart(staging.heatWeaponIndex);
+
+	PatchIndex(heatWeaponTable, heatWeaponRows,
+		[](FName rowName, uint8* row) { return FWeaponSpecId(reinterpret_cast<FHeatWeaponSpecification*>(row)->weaponSpecificationID); },
+		[this, &index](FWeaponSpecId weaponID, FName rowName, uint8* row) {
+			index.byWeaponID.Add(weaponID, reinterpret_cast<FHeatWeaponSpecification*>(row));
+			MarkArchetypeStale(weaponID);
+		},
+		[this, &index](FWeaponSpecId weaponID) {
+			index.byWeaponID.Remove(weaponID);
+			MarkArchetypeStale(weaponID);
+		});
+}
+
+void UDataTables::IndexAmmoWeapons()
+{
+	FSpecDatabase::TWeaponPartIndex<FAmmoWeaponSpecification>& index = EditPart(staging.ammoWeaponIndex);
+
+	PatchIndex(ammoWeaponTable, ammoWeaponRows,
+		[](FName rowName, uint8* row) { return FWeaponSpecId(reinterpret_cast<FAmmoWeaponSpecification*>(row)->weaponSpecificationID); },
+		[this, &index](FWeaponSpecId weaponID, FName rowName, uint8* row) {
+			index.byWeaponID.Add(weaponID, reinterpret_cast<FAmmoWeaponSpecification*>(row));
+			MarkArchetypeStale(weaponID);
+		},
+		[this, &index](FWeaponSpecId weaponID) {
+			index.byWeaponID.Remove(weaponID);
+			MarkArchetypeStale(weaponID);
+		});
+}
+
+void UDataTables::MarkArchetypeStale(FWeaponSpecId weaponID)
+{
+	const FItemId* itemID = staging.weaponIndex->itemIDsByWeaponID.Find(weaponID);
+
+	// A heat or ammo row for a weapon that isn't indexed yet is picked up when the weapon is
+	if (itemID != nullptr)
+		staleArchetypes.Add(*itemID);
+}
+
+void UDataTables::UpdateWeaponArchetypes()
+{
+	if (staleArchetypes.Num() == 0)
+		return;
+
+	FSpecDatabase::FArchetypeIndex& index = EditPart(staging.archetypeIndex);
+
+	for (FItemId itemID : staleArchetypes) {
+		const FWeaponSpecification* weaponSpec = staging.GetWeaponSpecification(itemID);
+		const int32* existing = index.byItemID.Find(itemID);
+
+		if (weaponSpec == nullptr) {
+			if (existing == nullptr)
+				continue;
+
+			// The last archetype moves into the gap, so its index entry follows it
+			int32 position = *existing;
+			index.byItemID.Remove(itemID);
+			index.archetypes.RemoveAtSwap(position, 1, false);
+
+			if (position < index.archetypes.Num())
+				index.byItemID[index.archetypes[position].itemID] = position;
+
+			continue;
+		}
+
+		FWeaponSpecId weaponID = staging.GetWeaponSpecificationID(itemID);
+
+		FWeaponArchetype archetype = {};
+		archetype.useRate = weaponSpec->useRate;
+		archetype.healthChange = weaponSpec->healthChange;
+		archetype.range = weaponSpec->range;
+		archetype.weaponType = weaponSpec->weaponType;
+		archetype.heals = weaponSpec->heals;
+		archetype.damageType = weaponSpec->damageType;
+		archetype.itemID = itemID;
+		archetype.weaponID = weaponID;
+		archetype.gunMesh = &weaponSpec->gunMesh;
+
+		if (const FHeatWeaponSpecification* heatSpec = staging.GetHeatWeaponSpecification(weaponID)) {
+			archetype.maxHeat = heatSpec->maxHeat;
+			archetype.heatGenerated = heatSpec->heatGenerated;
+			archetype.passiveHeatLoss = heatSpec->passiveHeatLoss;
+			archetype.overheatCooldown = heatSpec->overheatCooldown;
+		}
+
+		if (const FAmmoWeaponSpecification* ammoSpec = staging.GetAmmoWeaponSpecification(weaponID)) {
+			archetype.maxAmmo = ammoSpec->maxAmmo;
+			archetype.reloadSpeed = ammoSpec->reloadSpeed;
+		}
+
+		if (existing != nullptr) {
+			index.archetypes[*existing] = archetype;
+		}
+		else {
+			index.byItemID.Add(itemID, index.archetypes.Add(archetype));
+		}
+	}
+
+	staleArchetypes.Reset();
+}
+
+// Armour rows are named by their armourID, which armour value rows refer back to
+void UDataTables::IndexArmour()
+{
+	FSpecDatabase::FArmourIndex& index = EditPart(staging.armourIndex);
+
+	PatchIndex(armourTable, armourRows,
+		[](FName rowName, uint8* row) { return FItemId(reinterpret_cast<FArmourSpecification*>(row)->itemID); },
+		[&index](FItemId itemID, FName rowName, uint8* row) {
+			index.byItemID.Add(itemID, reinterpret_cast<FArmourSpecification*>(row));
+			index.armourIDsByItemID.Add(itemID, FArmourId::FromRowName(rowName));
+		},
+		[&index](FItemId itemID) {
+			index.byItemID.Remove(itemID);
+			index.armourIDsByItemID.Remove(itemID);
+		});
+}
+
+void UDataTables::IndexArmourValues()
+{
+	FSpecDatabase::FArmourValueIndex& index = EditPart(staging.armourValueIndex);
+	TArray<const FArmourValue*>& sortedArmourValues = index.sorted;
+
+	// Every piece has several values, so the key is shared and only tracked to spot rows moving between pieces
+	int32 keyChanges = PatchIndex(armourValuesTable, armourValueRows,
+		[](FName rowName, uint8* row) { return FArmourId(reinterpret_cast<FArmourValue*>(row)->armourID); },
+		[](FArmourId armourID, FName rowName, uint8* row) {},
+		[](FArmourId armourID) {},
+		false);
+
+	// No row moved to another piece, so every row keeps its slot and the spans are still right
+	if (keyChanges == 0) {
+		if (armourValuesTable != nullptr) {
+			for (const TPair<FName, uint8*>& row : armourValuesTable->GetRowMap()) {
+				sortedArmourValues[armourValuePositionsByRow.FindChecked(row.Key)] = reinterpret_cast<FArmourValue*>(row.Value);
+			}
+		}
+		return;
+	}
+
+	TArray<TPair<FName, const FArmourValue*>> rows;
+
+	if (armourValuesTable != nullptr) {
+		for (const TPair<FName, uint8*>& row : armourValuesTable->GetRowMap()) {
+			rows.Add(TPair<FName, const FArmourValue*>(row.Key, reinterpret_cast<FArmourValue*>(row.Value)));
+		}
+	}
+
+	// Stable so values for the same piece keep their table order
+	Algo::StableSortBy(rows, [](const TPair<FName, const FArmourValue*>& row) { return row.Value->armourID; });
+
+	sortedArmourValues.Reset(rows.Num());
+	armourValuePositionsByRow.Reset();
+	index.spans.Reset();
+
+	for (const TPair<FName, const FArmourValue*>& row : rows) {
+		armourValuePositionsByRow.Add(row.Key, sortedArmourValues.Add(row.Value));
+	}
+
+	int32 spanStart = 0;
+
+	for (int32 i = 1; i <= sortedArmourValues.Num(); i++) {
+		if (i == sortedArmourValues.Num() || sortedArmourValues[i]->armourID != sortedArmourValues[spanStart]->armourID) {
+			index.spans.Add(FArmourId(sortedArmourValues[spanStart]->armourID), FInt32Interval(spanStart, i));
+			spanStart = i;
+		}
+	}
 }
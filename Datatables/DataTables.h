@@ -5,6 +5,10 @@
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
 #include "Engine/DataTable.h"
+#include "SpecIds.h"
+#include "Async/Future.h"
+#include "Templates/Atomic.h"
+#include "Engine/StreamableManager.h"
 #include "DataTables.generated.h"
 
 UENUM(BlueprintType)
@@ -46,6 +50,40 @@ public:
 		TArray<int32> equippedArmour;
 };
 
+// One weighted drop in a loot table, every row sharing a lootTableID forms one table
+USTRUCT(BlueprintType)
+struct FLootEntry : public FTableRowBase
+{
+	GENERATED_USTRUCT_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 lootTableID;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 itemID;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		float weight = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 minQuantity = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 maxQuantity = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 minQuality = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 maxQuality = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 minGrade = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Loot")
+		int32 maxGrade = 0;
+};
+
 UENUM(BlueprintType)
 enum class  EWeaponType : uint8 {
 	NORMAL,
@@ -53,6 +91,15 @@ enum class  EWeaponType : uint8 {
 	HEAT
 };
 
+// Also the damage type a weapon deals, each armour type resists its own kind of damage
+UENUM(BlueprintType)
+enum class  EArmourType : uint8 {
+	PHYSICAL,
+	BLAST,
+	ENERGY,
+	RADIATION
+};
+
 USTRUCT(BlueprintType)
 struct FWeaponSpecification : public FTableRowBase
 {
@@ -76,6 +123,9 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Weapon Specification")
 		bool heals;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Weapon Specification")
+		EArmourType damageType;
+
 	//This array holds skeletal meshes for weapons 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Guns")
 		FString gunMesh;
@@ -166,14 +216,6 @@ public:
 		EPosition armourPosition;
 };
 
-UENUM(BlueprintType)
-enum class  EArmourType : uint8 {
-	PHYSICAL,
-	BLAST,
-	ENERGY,
-	RADIATION
-};
-
 USTRUCT(BlueprintType)
 struct FArmourValue : public FTableRowBase
 {
@@ -233,6 +275,154 @@ public:
 		float weight;
 };
 
+/**
+ * A weapon's item, weapon and heat or ammo specs joined into one cache line at table load,
+ * so firing reads a single contiguous record. Hot fields come first.
+ */
+struct alignas(PLATFORM_CACHE_LINE_SIZE) FWeaponArchetype
+{
+	float useRate;
+	float healthChange;
+	float range;
+	EWeaponType weaponType;
+	bool heals;
+	EArmourType damageType;
+
+	// Only the block matching weaponType is filled in
+	float maxHeat;
+	float heatGenerated;
+	float passiveHeatLoss;
+	float overheatCooldown;
+	float maxAmmo;
+	float reloadSpeed;
+
+	FItemId itemID;
+	FWeaponSpecId weaponID;
+
+	// Points into the weapon row, replaced along with the row on a table swap
+	const FString* gunMesh;
+};
+
+static_assert(sizeof(FWeaponArchetype) == PLATFORM_CACHE_LINE_SIZE, "FWeaponArchetype should fill exactly one cache line");
+
+/**
+ * Immutable snapshot of every spec row view and index.
+ * UDataTables builds a new one on the game thread whenever a table changes and publishes it with a single atomic pointer store.
+ * Each table's rows and indexes are a separate part, and a new snapshot shares the parts of every table that didn't change
+ * with the one before it, so a swap only copies the changed table's part.
+ * A published snapshot is never modified. A replaced one, and the tables it points into, is freed once its frame
+ * has ended and nothing holds it through UDataTables::AcquireSpecs.
+ */
+class SURVIVALGAME_API FSpecDatabase : public TSharedFromThis<FSpecDatabase, ESPMode::ThreadSafe>
+{
+public:
+	FSpecDatabase();
+
+	// Bumped on every publish, cache anything resolved from a snapshot against this
+	uint32 GetGeneration() const { return generation; }
+
+	TArrayView<const FItemSpecification* const> GetItems() const { return itemIndex->rows; }
+	TArrayView<const FWeaponSpecification* const> GetWeapons() const { return weaponIndex->rows; }
+	TArrayView<const FHeatWeaponSpecification* const> GetHeatWeapons() const { return heatWeaponIndex->rows; }
+	TArrayView<const FAmmoWeaponSpecification* const> GetAmmoWeapons() const { return ammoWeaponIndex->rows; }
+	TArrayView<const FArmourSpecification* const> GetArmour() const { return armourIndex->rows; }
+	TArrayView<const FArmourValue* const> GetArmourValues() const { return armourValueIndex->rows; }
+	TArrayView<const FLoadout* const> GetLoadouts() const { return loadoutRows->rows; }
+	TArrayView<const FLootEntry* const> GetLootEntries() const { return lootRows->rows; }
+
+	const FItemSpecification* GetItemSpecification(FItemId itemID) const;
+	const TMap<FItemId, const FItemSpecification*>& GetItemsByID() const { return itemIndex->byItemID; }
+	const FWeaponSpecification* GetWeaponSpecification(FItemId itemID) const;
+	FWeaponSpecId GetWeaponSpecificationID(FItemId itemID) const;
+	const FHeatWeaponSpecification* GetHeatWeaponSpecification(FWeaponSpecId weaponSpecificationID) const;
+	const FAmmoWeaponSpecification* GetAmmoWeaponSpecification(FWeaponSpecId weaponSpecificationID) const;
+	const FArmourSpecification* GetArmourSpecification(FItemId itemID) const;
+	FArmourId GetArmourID(FItemId itemID) const;
+	TArrayView<const FArmourValue* const> GetArmourValuesForArmour(FArmourId armourID) const;
+	const FWeaponArchetype* GetWeaponArchetype(FItemId itemID) const;
+
+private:
+	friend class UDataTables;
+
+	template<typename T>
+	struct TRowList
+	{
+		TArray<const T*> rows;
+	};
+
+	struct FItemIndex
+	{
+		TArray<const FItemSpecification*> rows;
+		TMap<FItemId, const FItemSpecification*> byItemID;
+	};
+
+	struct FWeaponIndex
+	{
+		TArray<const FWeaponSpecification*> rows;
+		TMap<FItemId, const FWeaponSpecification*> byItemID;
+		TMap<FItemId, FWeaponSpecId> weaponIDsByItemID;
+		// The way back from a heat or ammo row to the archetype it feeds
+		TMap<FWeaponSpecId, FItemId> itemIDsByWeaponID;
+	};
+
+	template<typename T>
+	struct TWeaponPartIndex
+	{
+		TArray<const T*> rows;
+		TMap<FWeaponSpecId, const T*> byWeaponID;
+	};
+
+	struct FArchetypeIndex
+	{
+		TArray<FWeaponArchetype, TAlignedHeapAllocator<PLATFORM_CACHE_LINE_SIZE>> archetypes;
+		TMap<FItemId, int32> byItemID;
+	};
+
+	struct FArmourIndex
+	{
+		TArray<const FArmourSpecification*> rows;
+		TMap<FItemId, const FArmourSpecification*> byItemID;
+		TMap<FItemId, FArmourId> armourIDsByItemID;
+	};
+
+	struct FArmourValueIndex
+	{
+		TArray<const FArmourValue*> rows;
+		// Sorted by armourID, so each piece's values are one contiguous span
+		TArray<const FArmourValue*> sorted;
+		TMap<FArmourId, FInt32Interval> spans;
+	};
+
+	uint32 generation = 0;
+
+	// Never null, only written through UDataTables::EditPart before the snapshot is published
+	TSharedPtr<const FItemIndex, ESPMode::ThreadSafe> itemIndex;
+	TSharedPtr<const FWeaponIndex, ESPMode::ThreadSafe> weaponIndex;
+	TSharedPtr<const TWeaponPartIndex<FHeatWeaponSpecification>, ESPMode::ThreadSafe> heatWeaponIndex;
+	TSharedPtr<const TWeaponPartIndex<FAmmoWeaponSpecification>, ESPMode::ThreadSafe> ammoWeaponIndex;
+	TSharedPtr<const FArchetypeIndex, ESPMode::ThreadSafe> archetypeIndex;
+	TSharedPtr<const FArmourIndex, ESPMode::ThreadSafe> armourIndex;
+	TSharedPtr<const FArmourValueIndex, ESPMode::ThreadSafe> armourValueIndex;
+	TSharedPtr<const TRowList<FLoadout>, ESPMode::ThreadSafe> loadoutRows;
+	TSharedPtr<const TRowList<FLootEntry>, ESPMode::ThreadSafe> lootRows;
+};
+
+typedef TSharedRef<const FSpecDatabase, ESPMode::ThreadSafe> FSpecDatabaseRef;
+
+// The key and row data each row of a table was last indexed with, and which row owns each key
+template<typename TKey>
+struct TSpecRowIndex
+{
+	struct FRow
+	{
+		TKey key;
+		uint8* data;
+	};
+
+	TMap<FName, FRow> rows;
+	TMap<TKey, FName> ownersByKey;
+};
+
 UCLASS()
 class SURVIVALGAME_API UDataTables : public UObject
 {
@@ -240,47 +430,255 @@ class SURVIVALGAME_API UDataTables : public UObject
 public:
 	UDataTables();
 
+	virtual void BeginDestroy() override;
+
+	// Game thread only, the first call creates the instance
 	static UDataTables* GetInstance();
 
-	TArray<FItemSpecification*> GetItems();
-	TArray<FWeaponSpecification*> GetWeapons();
-	TArray<FHeatWeaponSpecification*> GetHeatWeapons();
-	TArray<FAmmoWeaponSpecification*> GetAmmoWeapons();
-	TArray<FArmourSpecification*> GetArmour();
-	TArray<FArmourValue*> GetArmourValues();
-	TArray<FLoadout*> GetLoadouts();
+	// Latest published spec snapshot. On the game thread it stays valid until the end of the frame,
+	// anything holding it longer or reading it from another thread should use AcquireSpecs
+	static const FSpecDatabase* GetSpecs();
+
+	// Latest published spec snapshot, kept alive along with its tables for as long as the reference is held.
+	// Lock free from any thread, see ACQUIRING_READERS
+	static FSpecDatabaseRef AcquireSpecs();
+
+	// Synchronously loads every spec table asset and sets it
+	void LoadTables();
+
+	// Starts loading every spec table asset, then gathers and indexes the rows on a worker thread
+	void PreloadAsync();
+
+	bool IsReady() const { return tablesReady; }
+	TSharedFuture<void> GetReadyFuture() const { return readyFuture; }
 
+	// Runs callback on the game thread once the tables are indexed, straight away if they already are
+	void WhenReady(FSimpleDelegate callback);
+
+	// Blocks until the tables are indexed, on the game thread this finishes the outstanding loads first.
+	// Only for startup and tools, gameplay code should use WhenReady
+	void WaitUntilReady();
+
+	// Builds the row tables from a pack baked by FSpecPack::Bake instead of loading the UDataTable assets.
+	// The rows are unpacked into allocated copies, see FSpecPack
+	bool LoadSpecPack(const FString& path);
+
+	// Under the content directory, staged as a loose non-UFS file for server targets by SurvivalGame.Build.cs
+	static FString GetDefaultSpecPackPath();
+
+	// The setters below patch the staged indexes and publish a new snapshot, game thread only
 	UDataTable* GetItemTable() { return itemTable; }
-	void SetItemTable(UDataTable* val) { itemTable = val; }
+	void SetItemTable(UDataTable* val);
 
 	UDataTable* GetLoadoutTable() { return loadoutTable; }
-	void SetLoadoutTable(UDataTable* val) { loadoutTable = val; }
+	void SetLoadoutTable(UDataTable* val);
+
+	UDataTable* GetLootTable() { return lootTable; }
+	void SetLootTable(UDataTable* val);
 
 	UDataTable* GetWeaponTable() { return weaponTable; }
-	void SetWeaponTable(UDataTable* val) { weaponTable = val; }
+	void SetWeaponTable(UDataTable* val);
 
 	UDataTable* GetAbilitiesTable() { return abilitiesTable; }
-	void SetAbilitiesTable(UDataTable* val) { abilitiesTable = val; }
+	void SetAbilitiesTable(UDataTable* val);
 
 	UDataTable* GetArmourTable() { return armourTable; }
-	void SetArmourTable(UDataTable* val) { armourTable = val; }
+	void SetArmourTable(UDataTable* val);
 
 	UDataTable* GetArmourValuesTable() { return armourValuesTable; }
-	void SetArmourValuesTable(UDataTable* val) { armourValuesTable = val; }
+	void SetArmourValuesTable(UDataTable* val);
 
 	UDataTable* GetHeatWeaponTable() { return heatWeaponTable; }
-	void SetHeatWeaponTable(UDataTable* val) { heatWeaponTable = val; }
+	void SetHeatWeaponTable(UDataTable* val);
 
 	UDataTable* GetAmmoWeaponTable() { return ammoWeaponTable; }
-	void SetAmmoWeaponTable(UDataTable* val) { ammoWeaponTable = val; }
+	void SetAmmoWeaponTable(UDataTable* val);
 private:
 	static UDataTables* INSTANCE;
+	static TAtomic<const FSpecDatabase*> PUBLISHED_SPECS;
+
 	UDataTable* itemTable;
 	UDataTable* weaponTable;
 	UDataTable* heatWeaponTable;
 	UDataTable* ammoWeaponTable;
 	UDataTable* loadoutTable;
+	UDataTable* lootTable;
 	UDataTable* abilitiesTable;
 	UDataTable* armourTable;
 	UDataTable* armourValuesTable;
+
+	// Every table a live snapshot points into, rebuilt whenever snapshots are published or freed
+	UPROPERTY()
+		TArray<UDataTable*> referencedTables;
+
+	FStreamableManager streamableManager;
+	TSharedPtr<FStreamableHandle> preloadHandle;
+	bool indexingStarted;
+	bool readyPublished;
+
+	FThreadSafeBool tablesReady;
+	TPromise<void> readyPromise;
+	TSharedFuture<void> readyFuture;
+	TArray<FSimpleDelegate> readyCallbacks;
+
+	// Written by the indexing functions, a new snapshot copies its part pointers on publish
+	FSpecDatabase staging;
+
+	// Weapons whose weapon, heat or ammo rows changed since the archetypes were last updated
+	TSet<FItemId> staleArchetypes;
+	struct FPublishedSpecs
+	{
+		TSharedPtr<const FSpecDatabase, ESPMode::ThreadSafe> specs;
+		TArray<UDataTable*> tables;
+
+		// GFrameCounter when a newer snapshot replaced this one, 0 while it's current
+		uint64 retiredFrame;
+	};
+
+	// The current snapshot last, replaced ones until they can be freed
+	TArray<FPublishedSpecs> publishedSpecs;
+	FDelegateHandle reclaimTicker;
+
+	// AcquireSpecs calls between loading PUBLISHED_SPECS and pinning it. Counted before the load, so once
+	// ReclaimSpecs sees zero after a swap every later reader loads the new pointer, and it holds off freeing until then
+	static TAtomic<int32> ACQUIRING_READERS;
+
+	// Row gathering and indexing for the first load, published by FinishIndexing
+	TFuture<void> indexingTask;
+
+	// What each row was last filed under, used to patch the indexes when a table is swapped
+	TSpecRowIndex<FItemId> itemRows;
+	TSpecRowIndex<FItemId> weaponRows;
+	TSpecRowIndex<FWeaponSpecId> heatWeaponRows;
+	TSpecRowIndex<FWeaponSpecId> ammoWeaponRows;
+	TSpecRowIndex<FItemId> armourRows;
+	TSpecRowIndex<FArmourId> armourValueRows;
+	TMap<FName, int32> armourValuePositionsByRow;
+
+	// A part a published snapshot shares is copied first, so only the staged part is ever written
+	template<typename T>
+	static T& EditPart(TSharedPtr<const T, ESPMode::ThreadSafe>& part)
+	{
+		if (!part.IsUnique())
+			part = MakeShared<T, ESPMode::ThreadSafe>(*part);
+
+		// Every part is created non-const by MakeShared, and nothing else holds this one
+		return const_cast<T&>(*part);
+	}
+
+	template<typename T>
+	static void CacheRows(UDataTable* table, TArray<const T*>& rows)
+	{
+		TArray<T*> allRows;
+
+		if (table != nullptr)
+			table->GetAllRows<T>(TEXT("UDataTables"), allRows);
+
+		rows.Reset(allRows.Num());
+		rows.Append(allRows);
+	}
+
+	/**
+	 * Brings an index in line with table. Rows still pointing at the same data under the same key are skipped,
+	 * only rows that were added, removed, moved to new data or changed key reach setEntry and removeEntry.
+	 * With uniqueKeys the first row filed under a key owns it, later rows with the same key are logged and
+	 * left out until the owner goes. Returns how many rows were added, removed or changed key.
+	 */
+	template<typename TKey, typename TGetKey, typename TSetEntry, typename TRemoveEntry>
+	static int32 PatchIndex(UDataTable* table, TSpecRowIndex<TKey>& index, TGetKey getKey, TSetEntry setEntry, TRemoveEntry removeEntry, bool uniqueKeys = true)
+	{
+		int32 keyChanges = 0;
+		const TMap<FName, uint8*> noRows;
+		const TMap<FName, uint8*>& rows = table != nullptr ? table->GetRowMap() : noRows;
+		TSet<TKey> releasedKeys;
+
+		// Drop stale keys first so a key moving between two rows isn't removed after being re-added
+		for (auto rowIt = index.rows.CreateIterator(); rowIt; ++rowIt) {
+			uint8* const* row = rows.Find(rowIt.Key());
+
+			if (row != nullptr && getKey(rowIt.Key(), *row) == rowIt.Value().key)
+				continue;
+
+			const TKey key = rowIt.Value().key;
+
+			if (!uniqueKeys || index.ownersByKey.FindRef(key) == rowIt.Key()) {
+				removeEntry(key);
+				index.ownersByKey.Remove(key);
+				releasedKeys.Add(key);
+			}
+
+			rowIt.RemoveCurrent();
+			keyChanges++;
+		}
+
+		for (const TPair<FName, uint8*>& row : rows) {
+			typename TSpecRowIndex<TKey>::FRow* indexed = index.rows.Find(row.Key);
+
+			if (indexed != nullptr && indexed->data == row.Value)
+				continue;
+
+			TKey key = getKey(row.Key, row.Value);
+
+			if (indexed == nullptr) {
+				index.rows.Add(row.Key, { key, row.Value });
+				keyChanges++;
+			}
+			else {
+				indexed->data = row.Value;
+			}
+
+			const FName* owner = index.ownersByKey.Find(key);
+
+			if (!uniqueKeys || owner == nullptr || *owner == row.Key) {
+				if (uniqueKeys)
+					index.ownersByKey.Add(key, row.Key);
+
+				setEntry(key, row.Key, row.Value);
+			}
+			else {
+				UE_LOG(LogTemp, Warning, TEXT("%s: row %s has the same key as row %s and is ignored"), *table->GetName(), *row.Key.ToString(), *owner->ToString());
+			}
+		}
+
+		// A duplicate that was shadowed by a removed owner takes its key over
+		if (uniqueKeys && releasedKeys.Num() > 0) {
+			for (const TPair<FName, typename TSpecRowIndex<TKey>::FRow>& row : index.rows) {
+				if (releasedKeys.Contains(row.Value.key) && !index.ownersByKey.Contains(row.Value.key)) {
+					index.ownersByKey.Add(row.Value.key, row.Key);
+					setEntry(row.Value.key, row.Key, row.Value.data);
+				}
+			}
+		}
+
+		return keyChanges;
+	}
+
+	static TArray<FSoftObjectPath> GetTablePaths();
+	void OnTablesLoaded();
+
+	// Waits for the first load's indexing and publishes it, game thread only.
+	// The setters call it first so they never patch staging while the worker is indexing it
+	void FinishIndexing();
+
+	// Shares the staged parts with a new snapshot and swaps it in, game thread only
+	void PublishSpecs();
+
+	// Frees replaced snapshots whose frame has ended and that nobody has acquired, then drops tables only they used
+	void ReclaimSpecs();
+	bool TickReclaim(float deltaTime);
+
+	// Sets the ready future, safe from any thread
+	void SetReady();
+	// Runs anything waiting on WhenReady, game thread only
+	void PublishReady();
+
+	void IndexItems();
+	void IndexWeapons();
+	void IndexHeatWeapons();
+	void IndexAmmoWeapons();
+	void MarkArchetypeStale(FWeaponSpecId weaponID);
+	// Rebuilds the archetypes in staleArchetypes, adding and removing them as weapons come and go
+	void UpdateWeaponArchetypes();
+	void IndexArmour();
+	void IndexArmourValues();
 };
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Strongly typed integer handle for a spec row, so an item ID can't be passed where an armour ID is expected.
+ * Rows are keyed by these in the UDataTables indexes, looking one up never goes through FName or FString.
+ */
+template<typename TTag>
+struct TSpecId
+{
+	int32 value;
+
+	TSpecId() : value(INDEX_NONE) {}
+	explicit TSpecId(int32 inValue) : value(inValue) {}
+
+	// Row names are the ID as text, this is only done once per row when a table is indexed
+	static TSpecId FromRowName(FName rowName) { return TSpecId(FCString::Atoi(*rowName.ToString())); }
+
+	bool IsValid() const { return value != INDEX_NONE; }
+
+	bool operator==(TSpecId other) const { return value == other.value; }
+	bool operator!=(TSpecId other) const { return value != other.value; }
+
+	friend uint32 GetTypeHash(TSpecId id) { return ::GetTypeHash(id.value); }
+};
+
+struct FItemIdTag {};
+struct FWeaponSpecIdTag {};
+struct FArmourIdTag {};
+
+using FItemId = TSpecId<FItemIdTag>;
+using FWeaponSpecId = TSpecId<FWeaponSpecIdTag>;
+using FArmourId = TSpecId<FArmourIdTag>;
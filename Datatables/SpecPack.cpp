@@ -0,0 +1,670 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SpecPack.h"
+#include "DataTables.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/StableSort.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	const uint32 ColumnAlignment = 16;
+
+	struct FSpecPackHeader
+	{
+		uint32 magic;
+		uint32 version;
+		uint32 columnCount;
+		int32 rowCounts[10];
+	};
+
+	struct FSpecPackColumnEntry
+	{
+		uint32 offset;
+		uint32 num;
+		uint32 elementSize;
+	};
+
+	struct FColumnCounter
+	{
+		uint32 count = 0;
+
+		template<typename T>
+		void operator()(T&) { count++; }
+	};
+
+	struct FColumnWriter
+	{
+		TArray<uint8>& buffer;
+		TArray<FSpecPackColumnEntry>& entries;
+
+		template<typename T>
+		void operator()(TArray<T>& column)
+		{
+			buffer.SetNumZeroed(Align(buffer.Num(), ColumnAlignment));
+			entries.Add({ (uint32)buffer.Num(), (uint32)column.Num(), (uint32)sizeof(T) });
+			buffer.Append(reinterpret_cast<const uint8*>(column.GetData()), column.Num() * sizeof(T));
+		}
+	};
+
+	struct FColumnReader
+	{
+		const uint8* base;
+		int64 size;
+		const FSpecPackColumnEntry* entries;
+		uint32 numEntries;
+		uint32 next;
+		int32 expectedRows;
+		bool valid;
+
+		template<typename T>
+		void operator()(TSpecPackColumnView<T>& column)
+		{
+			if (!valid || next >= numEntries) {
+				valid = false;
+				return;
+			}
+
+			const FSpecPackColumnEntry& entry = entries[next++];
+
+			if (entry.elementSize != sizeof(T)
+				|| (expectedRows != INDEX_NONE && entry.num != (uint32)expectedRows)
+				|| entry.offset % ColumnAlignment != 0
+				|| (int64)entry.offset + (int64)entry.num * sizeof(T) > size) {
+				valid = false;
+				return;
+			}
+
+			column.data = reinterpret_cast<const T*>(base + entry.offset);
+			column.num = (int32)entry.num;
+		}
+	};
+
+	template<typename T>
+	TArray<TPair<int32, T*>> GetRowsByID(UDataTable* table)
+	{
+		TArray<TPair<int32, T*>> rows;
+
+		if (table != nullptr) {
+			for (const TPair<FName, uint8*>& row : table->GetRowMap()) {
+				rows.Add(TPair<int32, T*>(FCString::Atoi(*row.Key.ToString()), reinterpret_cast<T*>(row.Value)));
+			}
+		}
+
+		rows.Sort([](const TPair<int32, T*>& a, const TPair<int32, T*>& b) { return a.Key < b.Key; });
+		return rows;
+	}
+
+	int32 FindSorted(const TSpecPackColumnView<int32>& column, int32 num, int32 value)
+	{
+		return Algo::BinarySearch(TArrayView<const int32>(column.data, num), value);
+	}
+
+	// Every row of an index column is INDEX_NONE or a row of a section with num rows
+	bool IndexesInRange(const TSpecPackColumnView<int32>& column, int32 rows, int32 num)
+	{
+		for (int32 i = 0; i < rows; i++) {
+			if (column[i] != INDEX_NONE && (column[i] < 0 || column[i] >= num))
+				return false;
+		}
+
+		return true;
+	}
+
+	// stride is how many values each counted entry takes
+	bool RangesInRange(const TSpecPackColumnView<int32>& first, const TSpecPackColumnView<int32>& count, int32 rows, int32 num, int32 stride = 1)
+	{
+		for (int32 i = 0; i < rows; i++) {
+			if (first[i] < 0 || count[i] < 0 || (int64)first[i] + (int64)count[i] * stride > num)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool StringsInRange(const TSpecPackColumnView<FSpecPackString>& column, int32 rows, int32 poolSize)
+	{
+		for (int32 i = 0; i < rows; i++) {
+			if ((int64)column[i].offset + column[i].length > poolSize)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool EnumsInRange(const TSpecPackColumnView<uint8>& column, int32 rows, uint8 maxValue)
+	{
+		for (int32 i = 0; i < rows; i++) {
+			if (column[i] > maxValue)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Heat, ammo and armour value rows have no id of their own, so they are named by position
+	FName MakeRowName(int32 id)
+	{
+		return FName(*FString::FromInt(id));
+	}
+}
+
+FSpecPack::~FSpecPack()
+{
+	delete mappedRegion;
+	delete mappedFile;
+}
+
+bool FSpecPack::Bake(UDataTables* dataTables, const FString& path)
+{
+	TSpecPackItems<TSpecPackColumnArray> outItems;
+	TSpecPackWeapons<TSpecPackColumnArray> outWeapons;
+	TSpecPackHeatWeapons<TSpecPackColumnArray> outHeatWeapons;
+	TSpecPackAmmoWeapons<TSpecPackColumnArray> outAmmoWeapons;
+	TSpecPackLoadouts<TSpecPackColumnArray> outLoadouts;
+	TSpecPackAbilities<TSpecPackColumnArray> outAbilities;
+	TSpecPackArmour<TSpecPackColumnArray> outArmour;
+	TSpecPackArmourValues<TSpecPackColumnArray> outArmourValues;
+	TSpecPackLootEntries<TSpecPackColumnArray> outLootEntries;
+	TSpecPackPools<TSpecPackColumnArray> outPools;
+
+	auto addString = [&outPools](const FString& string) {
+		FTCHARToUTF8 utf8(*string);
+		FSpecPackString packString = { (uint32)outPools.strings.Num(), (uint32)utf8.Length() };
+		outPools.strings.Append(utf8.Get(), utf8.Length());
+		return packString;
+	};
+
+	TArray<TPair<int32, FItemSpecification*>> itemRows = GetRowsByID<FItemSpecification>(dataTables->GetItemTable());
+	TArray<TPair<int32, FWeaponSpecification*>> weaponRows = GetRowsByID<FWeaponSpecification>(dataTables->GetWeaponTable());
+	TArray<TPair<int32, FAbilitySpecification*>> abilityRows = GetRowsByID<FAbilitySpecification>(dataTables->GetAbilitiesTable());
+	TArray<TPair<int32, FArmourSpecification*>> armourRows = GetRowsByID<FArmourSpecification>(dataTables->GetArmourTable());
+
+	TMap<int32, int32> itemIndexes;
+	TMap<int32, int32> weaponIndexes;
+	TMap<int32, int32> abilityIndexes;
+	TMap<int32, int32> armourIndexes;
+
+	for (int32 i = 0; i < itemRows.Num(); i++)
+		itemIndexes.Add(itemRows[i].Key, i);
+	for (int32 i = 0; i < weaponRows.Num(); i++)
+		weaponIndexes.Add(weaponRows[i].Key, i);
+	for (int32 i = 0; i < abilityRows.Num(); i++)
+		abilityIndexes.Add(abilityRows[i].Key, i);
+	for (int32 i = 0; i < armourRows.Num(); i++)
+		armourIndexes.Add(armourRows[i].Key, i);
+
+	auto findIndex = [](const TMap<int32, int32>& indexes, int32 id) {
+		const int32* index = indexes.Find(id);
+		return index != nullptr ? *index : INDEX_NONE;
+	};
+
+	// Items, with the weapon and armour back references filled in below
+	outItems.num = itemRows.Num();
+	for (const TPair<int32, FItemSpecification*>& row : itemRows) {
+		outItems.id.Add(row.Key);
+		outItems.itemType.Add((uint8)row.Value->itemType);
+		outItems.name.Add(addString(row.Value->name.ToString()));
+		outItems.stackLimit.Add(row.Value->stackLimit);
+		outItems.weight.Add(row.Value->weight);
+	}
+	outItems.weaponIndex.Init(INDEX_NONE, outItems.num);
+	outItems.armourIndex.Init(INDEX_NONE, outItems.num);
+
+	outWeapons.num = weaponRows.Num();
+	for (int32 i = 0; i < weaponRows.Num(); i++) {
+		FWeaponSpecification* weaponSpec = weaponRows[i].Value;
+		int32 itemIndex = findIndex(itemIndexes, weaponSpec->itemSpecificationID);
+
+		if (itemIndex != INDEX_NONE)
+			outItems.weaponIndex[itemIndex] = i;
+
+		outWeapons.id.Add(weaponRows[i].Key);
+		outWeapons.itemIndex.Add(itemIndex);
+		outWeapons.weaponType.Add((uint8)weaponSpec->weaponType);
+		outWeapons.useRate.Add(weaponSpec->useRate);
+		outWeapons.healthChange.Add(weaponSpec->healthChange);
+		outWeapons.range.Add(weaponSpec->range);
+		outWeapons.heals.Add(weaponSpec->heals ? 1 : 0);
+		outWeapons.damageType.Add((uint8)weaponSpec->damageType);
+		outWeapons.gunMesh.Add(addString(weaponSpec->gunMesh));
+		outWeapons.gunScale.Add(weaponSpec->gunScale);
+		outWeapons.relativeGunLocation.Add(weaponSpec->relativeGunLocation);
+		outWeapons.relativeMuzzleLocation.Add(weaponSpec->relativeMuzzleLocation);
+		outWeapons.relativeGunRotations.Add(weaponSpec->relativeGunRotations);
+	}
+	outWeapons.heatIndex.Init(INDEX_NONE, outWeapons.num);
+	outWeapons.ammoIndex.Init(INDEX_NONE, outWeapons.num);
+
+	for (const FHeatWeaponSpecification* heatSpec : UDataTables::GetSpecs()->GetHeatWeapons()) {
+		int32 weaponIndex = findIndex(weaponIndexes, heatSpec->weaponSpecificationID);
+
+		if (weaponIndex != INDEX_NONE)
+			outWeapons.heatIndex[weaponIndex] = outHeatWeapons.num;
+
+		outHeatWeapons.weaponIndex.Add(weaponIndex);
+		outHeatWeapons.maxHeat.Add(heatSpec->maxHeat);
+		outHeatWeapons.heatGenerated.Add(heatSpec->heatGenerated);
+		outHeatWeapons.passiveHeatLoss.Add(heatSpec->passiveHeatLoss);
+		outHeatWeapons.overheatCooldown.Add(heatSpec->overheatCooldown);
+		outHeatWeapons.num++;
+	}
+
+	for (const FAmmoWeaponSpecification* ammoSpec : UDataTables::GetSpecs()->GetAmmoWeapons()) {
+		int32 weaponIndex = findIndex(weaponIndexes, ammoSpec->weaponSpecificationID);
+
+		if (weaponIndex != INDEX_NONE)
+			outWeapons.ammoIndex[weaponIndex] = outAmmoWeapons.num;
+
+		outAmmoWeapons.weaponIndex.Add(weaponIndex);
+		outAmmoWeapons.maxAmmo.Add(ammoSpec->maxAmmo);
+		outAmmoWeapons.reloadSpeed.Add(ammoSpec->reloadSpeed);
+		outAmmoWeapons.num++;
+	}
+
+	outAbilities.num = abilityRows.Num();
+	for (const TPair<int32, FAbilitySpecification*>& row : abilityRows) {
+		outAbilities.id.Add(row.Key);
+		outAbilities.abilityName.Add(addString(row.Value->abilityName));
+		outAbilities.abilityCooldown.Add(row.Value->abilityCooldown);
+		outAbilities.abilityType.Add((uint8)row.Value->abilityType);
+	}
+
+	// Group armour values by the armour they belong to
+	TArray<TPair<int32, const FArmourValue*>> valueRows;
+	for (const FArmourValue* armourValue : UDataTables::GetSpecs()->GetArmourValues()) {
+		valueRows.Add(TPair<int32, const FArmourValue*>(findIndex(armourIndexes, armourValue->armourID), armourValue));
+	}
+	Algo::StableSortBy(valueRows, [](const TPair<int32, const FArmourValue*>& row) { return row.Key; });
+
+	outArmourValues.num = valueRows.Num();
+	for (const TPair<int32, const FArmourValue*>& row : valueRows) {
+		outArmourValues.armourIndex.Add(row.Key);
+		outArmourValues.armourType.Add((uint8)row.Value->armourType);
+		outArmourValues.armourValue.Add(row.Value->armourValue);
+	}
+
+	outArmour.num = armourRows.Num();
+	outArmour.firstValue.Init(0, outArmour.num);
+	outArmour.valueCount.Init(0, outArmour.num);
+	for (int32 i = 0; i < armourRows.Num(); i++) {
+		int32 itemIndex = findIndex(itemIndexes, armourRows[i].Value->itemID);
+
+		if (itemIndex != INDEX_NONE)
+			outItems.armourIndex[itemIndex] = i;
+
+		outArmour.id.Add(armourRows[i].Key);
+		outArmour.itemIndex.Add(itemIndex);
+		outArmour.armourPosition.Add((uint8)armourRows[i].Value->armourPosition);
+	}
+	for (int32 i = valueRows.Num() - 1; i >= 0; i--) {
+		if (valueRows[i].Key != INDEX_NONE) {
+			outArmour.firstValue[valueRows[i].Key] = i;
+			outArmour.valueCount[valueRows[i].Key]++;
+		}
+	}
+
+	TArrayView<const FLoadout* const> loadouts = UDataTables::GetSpecs()->GetLoadouts();
+	TArray<const FLoadout*> loadoutRows(loadouts.GetData(), loadouts.Num());
+	loadoutRows.Sort([](const FLoadout& a, const FLoadout& b) { return a.characterID < b.characterID; });
+
+	outLoadouts.num = loadoutRows.Num();
+	for (const FLoadout* loadout : loadoutRows) {
+		outLoadouts.characterID.Add(loadout->characterID);
+		outLoadouts.maxHealth.Add(loadout->maxHealth);
+		outLoadouts.maxSpeed.Add(loadout->maxSpeed);
+
+		outLoadouts.firstAbility.Add(outPools.ints.Num());
+		outLoadouts.abilityCount.Add(loadout->abilityIDs.Num());
+		for (int32 abilityID : loadout->abilityIDs)
+			outPools.ints.Add(findIndex(abilityIndexes, abilityID));
+
+		outLoadouts.firstWeapon.Add(outPools.ints.Num());
+		outLoadouts.weaponCount.Add(loadout->equippedWeapons.Num());
+		for (const TPair<EPosition, int32>& weaponPosition : loadout->equippedWeapons) {
+			outPools.ints.Add((int32)weaponPosition.Key);
+			outPools.ints.Add(findIndex(itemIndexes, weaponPosition.Value));
+		}
+
+		outLoadouts.firstArmour.Add(outPools.ints.Num());
+		outLoadouts.armourCount.Add(loadout->equippedArmour.Num());
+		for (int32 armourItemID : loadout->equippedArmour)
+			outPools.ints.Add(findIndex(itemIndexes, armourItemID));
+	}
+
+	outLootEntries.num = 0;
+	for (const FLootEntry* lootEntry : UDataTables::GetSpecs()->GetLootEntries()) {
+		outLootEntries.lootTableID.Add(lootEntry->lootTableID);
+		outLootEntries.itemID.Add(lootEntry->itemID);
+		outLootEntries.weight.Add(lootEntry->weight);
+		outLootEntries.minQuantity.Add(lootEntry->minQuantity);
+		outLootEntries.maxQuantity.Add(lootEntry->maxQuantity);
+		outLootEntries.minQuality.Add(lootEntry->minQuality);
+		outLootEntries.maxQuality.Add(lootEntry->maxQuality);
+		outLootEntries.minGrade.Add(lootEntry->minGrade);
+		outLootEntries.maxGrade.Add(lootEntry->maxGrade);
+		outLootEntries.num++;
+	}
+
+	FColumnCounter counter;
+	outItems.VisitColumns(counter);
+	outWeapons.VisitColumns(counter);
+	outHeatWeapons.VisitColumns(counter);
+	outAmmoWeapons.VisitColumns(counter);
+	outLoadouts.VisitColumns(counter);
+	outAbilities.VisitColumns(counter);
+	outArmour.VisitColumns(counter);
+	outArmourValues.VisitColumns(counter);
+	outLootEntries.VisitColumns(counter);
+	outPools.VisitColumns(counter);
+
+	int32 headerSize = sizeof(FSpecPackHeader) + counter.count * sizeof(FSpecPackColumnEntry);
+
+	TArray<uint8> buffer;
+	TArray<FSpecPackColumnEntry> entries;
+	buffer.SetNumZeroed(headerSize);
+	entries.Reserve(counter.count);
+
+	FColumnWriter writer = { buffer, entries };
+	outItems.VisitColumns(writer);
+	outWeapons.VisitColumns(writer);
+	outHeatWeapons.VisitColumns(writer);
+	outAmmoWeapons.VisitColumns(writer);
+	outLoadouts.VisitColumns(writer);
+	outAbilities.VisitColumns(writer);
+	outArmour.VisitColumns(writer);
+	outArmourValues.VisitColumns(writer);
+	outLootEntries.VisitColumns(writer);
+	outPools.VisitColumns(writer);
+
+	FSpecPackHeader header = { Magic, Version, counter.count,
+		{ outItems.num, outWeapons.num, outHeatWeapons.num, outAmmoWeapons.num, outLoadouts.num,
+		  outAbilities.num, outArmour.num, outArmourValues.num, outLootEntries.num, INDEX_NONE } };
+
+	FMemory::Memcpy(buffer.GetData(), &header, sizeof(header));
+	FMemory::Memcpy(buffer.GetData() + sizeof(header), entries.GetData(), entries.Num() * sizeof(FSpecPackColumnEntry));
+
+	return FFileHelper::SaveArrayToFile(buffer, *path);
+}
+
+TUniquePtr<FSpecPack> FSpecPack::Mount(const FString& path)
+{
+	IMappedFileHandle* mappedFile = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*path);
+
+	if (mappedFile == nullptr)
+		return nullptr;
+
+	TUniquePtr<FSpecPack> pack(new FSpecPack());
+	pack->mappedFile = mappedFile;
+	pack->mappedRegion = mappedFile->MapRegion(0, mappedFile->GetFileSize());
+
+	if (pack->mappedRegion == nullptr)
+		return nullptr;
+
+	const uint8* base = pack->mappedRegion->GetMappedPtr();
+	int64 size = pack->mappedRegion->GetMappedSize();
+
+	if (size < (int64)sizeof(FSpecPackHeader))
+		return nullptr;
+
+	const FSpecPackHeader* header = reinterpret_cast<const FSpecPackHeader*>(base);
+
+	if (header->magic != Magic || header->version != Version
+		|| (int64)sizeof(FSpecPackHeader) + (int64)header->columnCount * sizeof(FSpecPackColumnEntry) > size)
+		return nullptr;
+
+	FColumnReader reader = { base, size, reinterpret_cast<const FSpecPackColumnEntry*>(base + sizeof(FSpecPackHeader)),
+		header->columnCount, 0, INDEX_NONE, true };
+
+	auto readSection = [&reader](auto& section, int32 rowCount) {
+		section.num = FMath::Max(rowCount, 0);
+		reader.expectedRows = rowCount;
+		section.VisitColumns(reader);
+	};
+
+	readSection(pack->items, header->rowCounts[0]);
+	readSection(pack->weapons, header->rowCounts[1]);
+	readSection(pack->heatWeapons, header->rowCounts[2]);
+	readSection(pack->ammoWeapons, header->rowCounts[3]);
+	readSection(pack->loadouts, header->rowCounts[4]);
+	readSection(pack->abilities, header->rowCounts[5]);
+	readSection(pack->armour, header->rowCounts[6]);
+	readSection(pack->armourValues, header->rowCounts[7]);
+	readSection(pack->lootEntries, header->rowCounts[8]);
+	readSection(pack->pools, header->rowCounts[9]);
+
+	if (!reader.valid || !pack->Validate())
+		return nullptr;
+
+	return pack;
+}
+
+bool FSpecPack::Validate() const
+{
+	int32 numInts = pools.ints.num;
+	int32 numStrings = pools.strings.num;
+
+	return EnumsInRange(items.itemType, items.num, (uint8)EItemType::ARMOUR)
+		&& EnumsInRange(weapons.weaponType, weapons.num, (uint8)EWeaponType::HEAT)
+		&& EnumsInRange(weapons.damageType, weapons.num, (uint8)EArmourType::RADIATION)
+		&& EnumsInRange(abilities.abilityType, abilities.num, (uint8)EAbilityType::AOE)
+		&& EnumsInRange(armour.armourPosition, armour.num, (uint8)EPosition::BOTH_HANDS)
+		&& EnumsInRange(armourValues.armourType, armourValues.num, (uint8)EArmourType::RADIATION)
+		&& StringsInRange(items.name, items.num, numStrings)
+		&& IndexesInRange(items.weaponIndex, items.num, weapons.num)
+		&& IndexesInRange(items.armourIndex, items.num, armour.num)
+		&& IndexesInRange(weapons.itemIndex, weapons.num, items.num)
+		&& IndexesInRange(weapons.heatIndex, weapons.num, heatWeapons.num)
+		&& IndexesInRange(weapons.ammoIndex, weapons.num, ammoWeapons.num)
+		&& StringsInRange(weapons.gunMesh, weapons.num, numStrings)
+		&& IndexesInRange(heatWeapons.weaponIndex, heatWeapons.num, weapons.num)
+		&& IndexesInRange(ammoWeapons.weaponIndex, ammoWeapons.num, weapons.num)
+		&& RangesInRange(loadouts.firstAbility, loadouts.abilityCount, loadouts.num, numInts)
+		// Weapons are stored as (position, item) pairs
+		&& RangesInRange(loadouts.firstWeapon, loadouts.weaponCount, loadouts.num, numInts, 2)
+		&& RangesInRange(loadouts.firstArmour, loadouts.armourCount, loadouts.num, numInts)
+		&& LoadoutReferencesInRange()
+		&& StringsInRange(abilities.abilityName, abilities.num, numStrings)
+		&& IndexesInRange(armour.itemIndex, armour.num, items.num)
+		&& RangesInRange(armour.firstValue, armour.valueCount, armour.num, armourValues.num)
+		&& IndexesInRange(armourValues.armourIndex, armourValues.num, armour.num);
+}
+
+bool FSpecPack::LoadoutReferencesInRange() const
+{
+	auto inRange = [](int32 index, int32 num) { return index == INDEX_NONE || (index >= 0 && index < num); };
+
+	for (int32 i = 0; i < loadouts.num; i++) {
+		for (int32 abilityIndex : GetInts(loadouts.firstAbility[i], loadouts.abilityCount[i])) {
+			if (!inRange(abilityIndex, abilities.num))
+				return false;
+		}
+
+		TArrayView<const int32> weaponPairs = GetInts(loadouts.firstWeapon[i], loadouts.weaponCount[i] * 2);
+
+		for (int32 pair = 0; pair < weaponPairs.Num(); pair += 2) {
+			if (weaponPairs[pair] < 0 || weaponPairs[pair] > (int32)EPosition::BOTH_HANDS || !inRange(weaponPairs[pair + 1], items.num))
+				return false;
+		}
+
+		for (int32 itemIndex : GetInts(loadouts.firstArmour[i], loadouts.armourCount[i])) {
+			if (!inRange(itemIndex, items.num))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+int32 FSpecPack::FindItem(int32 itemID) const
+{
+	return FindSorted(items.id, items.num, itemID);
+}
+
+int32 FSpecPack::FindWeapon(int32 weaponSpecificationID) const
+{
+	return FindSorted(weapons.id, weapons.num, weaponSpecificationID);
+}
+
+int32 FSpecPack::FindAbility(int32 abilityID) const
+{
+	return FindSorted(abilities.id, abilities.num, abilityID);
+}
+
+int32 FSpecPack::FindArmour(int32 armourID) const
+{
+	return FindSorted(armour.id, armour.num, armourID);
+}
+
+int32 FSpecPack::FindLoadout(int32 characterID) const
+{
+	return FindSorted(loadouts.characterID, loadouts.num, characterID);
+}
+
+FString FSpecPack::GetString(FSpecPackString string) const
+{
+	check((int64)string.offset + string.length <= pools.strings.num);
+
+	FUTF8ToTCHAR converted(pools.strings.data + string.offset, string.length);
+	return FString(converted.Length(), converted.Get());
+}
+
+void FSpecPack::Unpack(UDataTables* dataTables) const
+{
+	auto makeTable = [dataTables](UScriptStruct* rowStruct) {
+		UDataTable* table = NewObject<UDataTable>(dataTables);
+		table->RowStruct = rowStruct;
+		return table;
+	};
+
+	// Cross references are row indexes in the pack and ids in the tables
+	auto itemID = [this](int32 itemIndex) { return itemIndex != INDEX_NONE ? items.id[itemIndex] : INDEX_NONE; };
+	auto weaponID = [this](int32 weaponIndex) { return weaponIndex != INDEX_NONE ? weapons.id[weaponIndex] : INDEX_NONE; };
+
+	UDataTable* itemTable = makeTable(FItemSpecification::StaticStruct());
+	for (int32 i = 0; i < items.num; i++) {
+		FItemSpecification row;
+		row.itemType = (EItemType)items.itemType[i];
+		row.name = FText::FromString(GetString(items.name[i]));
+		row.stackLimit = items.stackLimit[i];
+		row.weight = items.weight[i];
+		itemTable->AddRow(MakeRowName(items.id[i]), row);
+	}
+
+	UDataTable* weaponTable = makeTable(FWeaponSpecification::StaticStruct());
+	for (int32 i = 0; i < weapons.num; i++) {
+		FWeaponSpecification row;
+		row.itemSpecificationID = itemID(weapons.itemIndex[i]);
+		row.weaponType = (EWeaponType)weapons.weaponType[i];
+		row.useRate = weapons.useRate[i];
+		row.healthChange = weapons.healthChange[i];
+		row.range = weapons.range[i];
+		row.heals = weapons.heals[i] != 0;
+		row.damageType = (EArmourType)weapons.damageType[i];
+		row.gunMesh = GetString(weapons.gunMesh[i]);
+		row.gunScale = weapons.gunScale[i];
+		row.relativeGunLocation = weapons.relativeGunLocation[i];
+		row.relativeMuzzleLocation = weapons.relativeMuzzleLocation[i];
+		row.relativeGunRotations = weapons.relativeGunRotations[i];
+		weaponTable->AddRow(MakeRowName(weapons.id[i]), row);
+	}
+
+	UDataTable* heatWeaponTable = makeTable(FHeatWeaponSpecification::StaticStruct());
+	for (int32 i = 0; i < heatWeapons.num; i++) {
+		FHeatWeaponSpecification row;
+		row.weaponSpecificationID = weaponID(heatWeapons.weaponIndex[i]);
+		row.maxHeat = heatWeapons.maxHeat[i];
+		row.heatGenerated = heatWeapons.heatGenerated[i];
+		row.passiveHeatLoss = heatWeapons.passiveHeatLoss[i];
+		row.overheatCooldown = heatWeapons.overheatCooldown[i];
+		heatWeaponTable->AddRow(MakeRowName(i), row);
+	}
+
+	UDataTable* ammoWeaponTable = makeTable(FAmmoWeaponSpecification::StaticStruct());
+	for (int32 i = 0; i < ammoWeapons.num; i++) {
+		FAmmoWeaponSpecification row;
+		row.weaponSpecificationID = weaponID(ammoWeapons.weaponIndex[i]);
+		row.maxAmmo = ammoWeapons.maxAmmo[i];
+		row.reloadSpeed = ammoWeapons.reloadSpeed[i];
+		ammoWeaponTable->AddRow(MakeRowName(i), row);
+	}
+
+	UDataTable* abilitiesTable = makeTable(FAbilitySpecification::StaticStruct());
+	for (int32 i = 0; i < abilities.num; i++) {
+		FAbilitySpecification row;
+		row.abilityName = GetString(abilities.abilityName[i]);
+		row.abilityCooldown = abilities.abilityCooldown[i];
+		row.abilityType = (EAbilityType)abilities.abilityType[i];
+		abilitiesTable->AddRow(MakeRowName(abilities.id[i]), row);
+	}
+
+	UDataTable* armourTable = makeTable(FArmourSpecification::StaticStruct());
+	for (int32 i = 0; i < armour.num; i++) {
+		FArmourSpecification row;
+		row.itemID = itemID(armour.itemIndex[i]);
+		row.armourPosition = (EPosition)armour.armourPosition[i];
+		armourTable->AddRow(MakeRowName(armour.id[i]), row);
+	}
+
+	UDataTable* armourValuesTable = makeTable(FArmourValue::StaticStruct());
+	for (int32 i = 0; i < armourValues.num; i++) {
+		FArmourValue row;
+		row.armourID = armourValues.armourIndex[i] != INDEX_NONE ? armour.id[armourValues.armourIndex[i]] : INDEX_NONE;
+		row.armourType = (EArmourType)armourValues.armourType[i];
+		row.armourValue = armourValues.armourValue[i];
+		armourValuesTable->AddRow(MakeRowName(i), row);
+	}
+
+	UDataTable* loadoutTable = makeTable(FLoadout::StaticStruct());
+	for (int32 i = 0; i < loadouts.num; i++) {
+		FLoadout row;
+		row.characterID = loadouts.characterID[i];
+		row.maxHealth = loadouts.maxHealth[i];
+		row.maxSpeed = loadouts.maxSpeed[i];
+
+		for (int32 abilityIndex : GetInts(loadouts.firstAbility[i], loadouts.abilityCount[i])) {
+			row.abilityIDs.Add(abilityIndex != INDEX_NONE ? abilities.id[abilityIndex] : INDEX_NONE);
+		}
+
+		TArrayView<const int32> weaponPairs = GetInts(loadouts.firstWeapon[i], loadouts.weaponCount[i] * 2);
+
+		for (int32 pair = 0; pair < weaponPairs.Num(); pair += 2) {
+			row.equippedWeapons.Add((EPosition)weaponPairs[pair], itemID(weaponPairs[pair + 1]));
+		}
+
+		for (int32 itemIndex : GetInts(loadouts.firstArmour[i], loadouts.armourCount[i])) {
+			row.equippedArmour.Add(itemID(itemIndex));
+		}
+
+		loadoutTable->AddRow(MakeRowName(row.characterID), row);
+	}
+
+	UDataTable* lootTable = makeTable(FLootEntry::StaticStruct());
+	for (int32 i = 0; i < lootEntries.num; i++) {
+		FLootEntry row;
+		row.lootTableID = lootEntries.lootTableID[i];
+		row.itemID = lootEntries.itemID[i];
+		row.weight = lootEntries.weight[i];
+		row.minQuantity = lootEntries.minQuantity[i];
+		row.maxQuantity = lootEntries.maxQuantity[i];
+		row.minQuality = lootEntries.minQuality[i];
+		row.maxQuality = lootEntries.maxQuality[i];
+		row.minGrade = lootEntries.minGrade[i];
+		row.maxGrade = lootEntries.maxGrade[i];
+		lootTable->AddRow(MakeRowName(i), row);
+	}
+
+	// Items first, the weapon and armour indexes resolve against them
+	dataTables->SetItemTable(itemTable);
+	dataTables->SetWeaponTable(weaponTable);
+	dataTables->SetHeatWeaponTable(heatWeaponTable);
+	dataTables->SetAmmoWeaponTable(ammoWeaponTable);
+	dataTables->SetAbilitiesTable(abilitiesTable);
+	dataTables->SetArmourTable(armourTable);
+	dataTables->SetArmourValuesTable(armourValuesTable);
+	dataTables->SetLoadoutTable(loadoutTable);
+	dataTables->SetLootTable(lootTable);
+}
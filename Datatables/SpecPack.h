@@ -0,0 +1,288 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UDataTables;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Offset and length of a UTF-8 string in the pack's string pool
+struct FSpecPackString
+{
+	uint32 offset;
+	uint32 length;
+};
+
+// Read side column, points straight into the mapped file
+template<typename T>
+struct TSpecPackColumnView
+{
+	const T* data = nullptr;
+	int32 num = 0;
+
+	const T& operator[](int32 index) const { return data[index]; }
+};
+
+// Write side column, filled while baking
+template<typename T>
+using TSpecPackColumnArray = TArray<T>;
+
+/**
+ * Every table is stored as a structure of arrays, one fixed-size column per field.
+ * Cross references are stored as row indexes into the referenced section, INDEX_NONE when absent.
+ * Sections with an id column are sorted by it so lookups are a binary search over one column.
+ */
+template<template<typename> class TColumn>
+struct TSpecPackItems
+{
+	int32 num = 0;
+	TColumn<int32> id;
+	TColumn<uint8> itemType;
+	TColumn<FSpecPackString> name;
+	TColumn<int32> stackLimit;
+	TColumn<float> weight;
+	TColumn<int32> weaponIndex;
+	TColumn<int32> armourIndex;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(id); visitor(itemType); visitor(name); visitor(stackLimit); visitor(weight);
+		visitor(weaponIndex); visitor(armourIndex);
+	}
+};
+
+template<template<typename> class TColumn>
+struct TSpecPackWeapons
+{
+	int32 num = 0;
+	TColumn<int32> id;
+	TColumn<int32> itemIndex;
+	TColumn<uint8> weaponType;
+	TColumn<float> useRate;
+	TColumn<float> healthChange;
+	TColumn<float> range;
+	TColumn<uint8> heals;
+	TColumn<uint8> damageType;
+	TColumn<int32> heatIndex;
+	TColumn<int32> ammoIndex;
+	TColumn<FSpecPackString> gunMesh;
+	TColumn<FVector> gunScale;
+	TColumn<FVector> relativeGunLocation;
+	TColumn<FVector> relativeMuzzleLocation;
+	TColumn<FRotator> relativeGunRotations;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(id); visitor(itemIndex); visitor(weaponType); visitor(useRate); visitor(healthChange);
+		visitor(range); visitor(heals); visitor(damageType); visitor(heatIndex); visitor(ammoIndex); visitor(gunMesh);
+		visitor(gunScale); visitor(relativeGunLocation); visitor(relativeMuzzleLocation); visitor(relativeGunRotations);
+	}
+};
+
+template<template<typename> class TColumn>
+struct TSpecPackHeatWeapons
+{
+	int32 num = 0;
+	TColumn<int32> weaponIndex;
+	TColumn<float> maxHeat;
+	TColumn<float> heatGenerated;
+	TColumn<float> passiveHeatLoss;
+	TColumn<float> overheatCooldown;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(weaponIndex); visitor(maxHeat); visitor(heatGenerated); visitor(passiveHeatLoss); visitor(overheatCooldown);
+	}
+};
+
+template<template<typename> class TColumn>
+struct TSpecPackAmmoWeapons
+{
+	int32 num = 0;
+	TColumn<int32> weaponIndex;
+	TColumn<float> maxAmmo;
+	TColumn<float> reloadSpeed;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(weaponIndex); visitor(maxAmmo); visitor(reloadSpeed);
+	}
+};
+
+// Variable length loadout data lives in the int pool as first/count ranges
+template<template<typename> class TColumn>
+struct TSpecPackLoadouts
+{
+	int32 num = 0;
+	TColumn<int32> characterID;
+	TColumn<float> maxHealth;
+	TColumn<float> maxSpeed;
+	TColumn<int32> firstAbility;
+	TColumn<int32> abilityCount;
+	// Pairs of (EPosition, item index)
+	TColumn<int32> firstWeapon;
+	TColumn<int32> weaponCount;
+	TColumn<int32> firstArmour;
+	TColumn<int32> armourCount;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(characterID); visitor(maxHealth); visitor(maxSpeed); visitor(firstAbility); visitor(abilityCount);
+		visitor(firstWeapon); visitor(weaponCount); visitor(firstArmour); visitor(armourCount);
+	}
+};
+
+template<template<typename> class TColumn>
+struct TSpecPackAbilities
+{
+	int32 num = 0;
+	TColumn<int32> id;
+	TColumn<FSpecPackString> abilityName;
+	TColumn<float> abilityCooldown;
+	TColumn<uint8> abilityType;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(id); visitor(abilityName); visitor(abilityCooldown); visitor(abilityType);
+	}
+};
+
+// Armour values are sorted by armour so each piece owns one contiguous range
+template<template<typename> class TColumn>
+struct TSpecPackArmour
+{
+	int32 num = 0;
+	TColumn<int32> id;
+	TColumn<int32> itemIndex;
+	TColumn<uint8> armourPosition;
+	TColumn<int32> firstValue;
+	TColumn<int32> valueCount;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(id); visitor(itemIndex); visitor(armourPosition); visitor(firstValue); visitor(valueCount);
+	}
+};
+
+template<template<typename> class TColumn>
+struct TSpecPackArmourValues
+{
+	int32 num = 0;
+	TColumn<int32> armourIndex;
+	TColumn<uint8> armourType;
+	TColumn<float> armourValue;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(armourIndex); visitor(armourType); visitor(armourValue);
+	}
+};
+
+template<template<typename> class TColumn>
+struct TSpecPackLootEntries
+{
+	int32 num = 0;
+	TColumn<int32> lootTableID;
+	TColumn<int32> itemID;
+	TColumn<float> weight;
+	TColumn<int32> minQuantity;
+	TColumn<int32> maxQuantity;
+	TColumn<int32> minQuality;
+	TColumn<int32> maxQuality;
+	TColumn<int32> minGrade;
+	TColumn<int32> maxGrade;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(lootTableID); visitor(itemID); visitor(weight); visitor(minQuantity); visitor(maxQuantity);
+		visitor(minQuality); visitor(maxQuality); visitor(minGrade); visitor(maxGrade);
+	}
+};
+
+template<template<typename> class TColumn>
+struct TSpecPackPools
+{
+	int32 num = 0;
+	TColumn<int32> ints;
+	TColumn<ANSICHAR> strings;
+
+	template<typename TVisitor>
+	void VisitColumns(TVisitor& visitor)
+	{
+		visitor(ints); visitor(strings);
+	}
+};
+
+/**
+ * Flattened, versioned binary copy of every table behind UDataTables.
+ * The pack is memory mapped read only, and every range in it is validated when it is mounted.
+ * Dedicated servers unpack it into in-memory tables instead of loading and deserialising the table assets.
+ * FSpecDatabase and the item factories hand out row struct pointers with FText and FString fields, which
+ * can't point into the mapping, so unpacking still allocates every row and the pages aren't shared once
+ * the pack is released. What it saves is the asset loads and the tagged property deserialisation.
+ */
+class SURVIVALGAME_API FSpecPack
+{
+public:
+	static const uint32 Magic = 0x50534753; // "SGSP"
+	static const uint32 Version = 3;
+
+	~FSpecPack();
+
+	// Cook step, flattens the tables currently set on dataTables into a pack file
+	static bool Bake(UDataTables* dataTables, const FString& path);
+
+	// Maps a baked pack, returns nullptr if it is missing, truncated, from another version or has a reference out of range
+	static TUniquePtr<FSpecPack> Mount(const FString& path);
+
+	// Rebuilds every table from the pack and sets them on dataTables, which indexes and publishes them as usual.
+	// One AddRow per row, the rows are copies and nothing points back into the pack afterwards
+	void Unpack(UDataTables* dataTables) const;
+
+	TSpecPackItems<TSpecPackColumnView> items;
+	TSpecPackWeapons<TSpecPackColumnView> weapons;
+	TSpecPackHeatWeapons<TSpecPackColumnView> heatWeapons;
+	TSpecPackAmmoWeapons<TSpecPackColumnView> ammoWeapons;
+	TSpecPackLoadouts<TSpecPackColumnView> loadouts;
+	TSpecPackAbilities<TSpecPackColumnView> abilities;
+	TSpecPackArmour<TSpecPackColumnView> armour;
+	TSpecPackArmourValues<TSpecPackColumnView> armourValues;
+	TSpecPackLootEntries<TSpecPackColumnView> lootEntries;
+	TSpecPackPools<TSpecPackColumnView> pools;
+
+	// Row lookups by id, INDEX_NONE when missing
+	int32 FindItem(int32 itemID) const;
+	int32 FindWeapon(int32 weaponSpecificationID) const;
+	int32 FindAbility(int32 abilityID) const;
+	int32 FindArmour(int32 armourID) const;
+	int32 FindLoadout(int32 characterID) const;
+
+	TArrayView<const int32> GetInts(int32 first, int32 count) const
+	{
+		check(first >= 0 && count >= 0 && (int64)first + count <= pools.ints.num);
+		return TArrayView<const int32>(pools.ints.data + first, count);
+	}
+
+	FString GetString(FSpecPackString string) const;
+
+private:
+	FSpecPack() {}
+
+	// Every string, pool range and cross reference lands inside the pack
+	bool Validate() const;
+	bool LoadoutReferencesInRange() const;
+
+	IMappedFileHandle* mappedFile = nullptr;
+	IMappedFileRegion* mappedRegion = nullptr;
+};
@@ -1,50 +1,36 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "Armour.h"
+#include "../ItemPool.h"
 
-UArmour* UArmour::CreateArmour(int32 itemID, FItemSpecification armourItemSpecification)
+UArmour* UArmour::CreateArmour(int32 itemID)
 {
-	UArmour* armour = NewObject<UArmour>();
-	armour->SetItemSpecification(armourItemSpecification);
-
-	GetArmourSpecification(itemID, armour);
-	
-	for (FArmourSpecification* armourSpec : UDataTables::GetInstance()->GetArmour()) {
-		if (armourSpec->itemID == itemID) {
-			armour->SetArmourSpecification(armourSpec);
-		}
-	}
+	UArmour* armour = UItemPool::GetInstance()->Acquire<UArmour>();
+	armour->SetItemID(FItemId(itemID));
 
 	return armour;
 }
 
-void UArmour::GetArmourSpecification(int32 itemID, UArmour* armour)
+const FArmourSpecification* UArmour::GetArmourSpecification()
 {
-	static const FString ContextString(TEXT("GENERAL"));
-	FName armourIDText = *FString::Printf(TEXT("%d"), itemID);
-
-	UDataTable* armourTable = UDataTables::GetInstance()->GetArmourTable();
-
-	for (FName armourID : armourTable->GetRowNames()) {
-		FArmourSpecification* armourSpec = armourTable->FindRow<FArmourSpecification>(armourID, ContextString, true);
-
-		if (armourSpec != nullptr) {
-			if (armourSpec->itemID == itemID) {
-				armour->SetArmourSpecification(armourSpec);
-				GetArmourValuesForArmour(armour, armourID);
-				break;
-			}
-		}
-	}
+	ResolveSpecification();
+	return armourSpecification;
 }
 
-void UArmour::GetArmourValuesForArmour(UArmour* armour, FName armourID)
+TArrayView<const FArmourValue* const> UArmour::GetArmourValues()
 {
-	int32 armourIDint = FCString::Atoi(*armourID.ToString());
+	ResolveSpecification();
+	return armourValues;
+}
+
+void UArmour::ResolveSpecification()
+{
+	const FSpecDatabase* specs = UDataTables::GetSpecs();
+
+	if (armourSpecification != nullptr && specGeneration == specs->GetGeneration())
+		return;
 
-	for (FArmourValue* armourValue : UDataTables::GetInstance()->GetArmourValues()) {
-		if (armourValue->armourID == armourIDint) {
-			armour->GetArmourValues().Add(armourValue);
-		}
-	}
+	armourSpecification = specs->GetArmourSpecification(GetItemID());
+	armourValues = specs->GetArmourValuesForArmour(specs->GetArmourID(GetItemID()));
+	specGeneration = specs->GetGeneration();
 }
@@ -16,16 +16,17 @@ class SURVIVALGAME_API UArmour : public UItem
 	GENERATED_BODY()
 
 public:
-	static UArmour* CreateArmour(int32 itemID, FItemSpecification armourSpecification);
+	static UArmour* CreateArmour(int32 itemID);
 
-	static void GetArmourSpecification(int32 itemID, UArmour* armour);
+	const FArmourSpecification* GetArmourSpecification();
+	TArrayView<const FArmourValue* const> GetArmourValues();
 
-	FArmourSpecification* GetArmourSpecification() { return armourSpecification; }
-	void SetArmourSpecification(FArmourSpecification* val) { armourSpecification = val; }
-
-	TArray<FArmourValue *>& GetArmourValues() { return armourValues; }
+	virtual void SetItemID(FItemId val) override { Super::SetItemID(val); armourSpecification = nullptr; }
 private:
-	FArmourSpecification * armourSpecification;
-	TArray<FArmourValue*> armourValues;
-	static void GetArmourValuesForArmour(UArmour* armour, FName armourID);
+	// Re-resolved through the item id whenever the spec tables are swapped
+	const FArmourSpecification * armourSpecification;
+	TArrayView<const FArmourValue* const> armourValues;
+	uint32 specGeneration;
+
+	void ResolveSpecification();
 };
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ContainerJournal.h"
+
+namespace
+{
+	void WriteVarint(TArray<uint8>& out, uint32 value)
+	{
+		while (value >= 0x80) {
+			out.Add((uint8)(value | 0x80));
+			value >>= 7;
+		}
+		out.Add((uint8)value);
+	}
+
+	bool ReadVarint(const TArray<uint8>& in, int32& offset, uint32& outValue)
+	{
+		outValue = 0;
+
+		for (int32 shift = 0; shift < 35; shift += 7) {
+			if (offset >= in.Num())
+				return false;
+
+			uint8 byte = in[offset++];
+			outValue |= (uint32)(byte & 0x7F) << shift;
+
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	uint32 ZigZag(int32 value)
+	{
+		return ((uint32)value << 1) ^ (uint32)(value >> 31);
+	}
+
+	int32 UnZigZag(uint32 value)
+	{
+		return (int32)(value >> 1) ^ -(int32)(value & 1);
+	}
+}
+
+void FContainerJournal::Record(int32 itemID, int32 countChange)
+{
+	entryOffsets.Add(entries.Num());
+	WriteVarint(entries, ZigZag(itemID));
+	WriteVarint(entries, ZigZag(countChange));
+
+	// Compacted in halves so the copy down happens once every MaxHistory / 2 changes
+	if (entryOffsets.Num() > MaxHistory)
+		Compact(GetVersion() - MaxHistory / 2);
+}
+
+bool FContainerJournal::Diff(int32 fromVersion, int32 toVersion, TArray<uint8>& outDiff) const
+{
+	if (fromVersion < baseVersion || toVersion > GetVersion() || fromVersion > toVersion)
+		return false;
+
+	TMap<int32, int32> countChanges;
+	int32 offset = fromVersion == toVersion ? 0 : entryOffsets[fromVersion - baseVersion];
+
+	for (int32 version = fromVersion; version < toVersion; version++) {
+		uint32 itemID;
+		uint32 countChange;
+
+		if (!ReadVarint(entries, offset, itemID) || !ReadVarint(entries, offset, countChange))
+			return false;
+
+		countChanges.FindOrAdd(UnZigZag(itemID)) += UnZigZag(countChange);
+	}
+
+	EncodeDiff(fromVersion, toVersion, countChanges, outDiff);
+	return true;
+}
+
+void FContainerJournal::Compact(int32 oldestVersion)
+{
+	int32 dropped = FMath::Clamp(oldestVersion, baseVersion, GetVersion()) - baseVersion;
+
+	if (dropped == 0)
+		return;
+
+	int32 droppedBytes = dropped < entryOffsets.Num() ? entryOffsets[dropped] : entries.Num();
+	entries.RemoveAt(0, droppedBytes, false);
+	entryOffsets.RemoveAt(0, dropped, false);
+
+	for (int32& entryOffset : entryOffsets) {
+		entryOffset -= droppedBytes;
+	}
+
+	baseVersion += dropped;
+}
+
+void FContainerJournal::Reset(int32 version)
+{
+	entries.Reset();
+	entryOffsets.Reset();
+	baseVersion = version;
+}
+
+void FContainerJournal::EncodeDiff(int32 fromVersion, int32 toVersion, const TMap<int32, int32>& countChanges, TArray<uint8>& outDiff)
+{
+	TArray<TPair<int32, int32>> sorted;
+	sorted.Reserve(countChanges.Num());
+
+	for (const TPair<int32, int32>& countChange : countChanges) {
+		// Changes that cancelled out cost nothing
+		if (countChange.Value != 0)
+			sorted.Add(countChange);
+	}
+
+	sorted.Sort([](const TPair<int32, int32>& a, const TPair<int32, int32>& b) { return a.Key < b.Key; });
+
+	outDiff.Reset();
+	WriteVarint(outDiff, (uint32)fromVersion);
+	WriteVarint(outDiff, (uint32)toVersion);
+	WriteVarint(outDiff, (uint32)sorted.Num());
+
+	for (int32 i = 0; i < sorted.Num(); i++) {
+		// Ids are sorted, so every step after the first is positive. Two ids can be further apart than
+		// an int32 reaches, so the step is taken in int64 and written unsigned, where it always fits
+		if (i == 0)
+			WriteVarint(outDiff, ZigZag(sorted[i].Key));
+		else
+			WriteVarint(outDiff, (uint32)((int64)sorted[i].Key - sorted[i - 1].Key));
+
+		WriteVarint(outDiff, ZigZag(sorted[i].Value));
+	}
+}
+
+bool FContainerJournal::DecodeDiff(const TArray<uint8>& diff, int32& outFromVersion, int32& outToVersion, TArray<TPair<int32, int32>>& outCountChanges)
+{
+	int32 offset = 0;
+	uint32 fromVersion;
+	uint32 toVersion;
+	uint32 count;
+
+	if (!ReadVarint(diff, offset, fromVersion) || !ReadVarint(diff, offset, toVersion) || !ReadVarint(diff, offset, count))
+		return false;
+
+	if (fromVersion > (uint32)MAX_int32 || toVersion > (uint32)MAX_int32 || fromVersion > toVersion)
+		return false;
+
+	// Every entry is at least two bytes, so a bigger count can only be corrupt
+	if (count > (uint32)(diff.Num() - offset) / 2)
+		return false;
+
+	outCountChanges.Reset(count);
+	int64 itemID = 0;
+
+	for (uint32 i = 0; i < count; i++) {
+		uint32 idDelta;
+		uint32 countChange;
+
+		if (!ReadVarint(diff, offset, idDelta) || !ReadVarint(diff, offset, countChange))
+			return false;
+
+		// Ids are unique and sorted, so a repeat could only be crafted. A repeated id would
+		// otherwise pass ApplyDiff's per entry checks and remove more than the container holds
+		if ((i > 0 && idDelta == 0) || UnZigZag(countChange) == 0)
+			return false;
+
+		itemID = i == 0 ? UnZigZag(idDelta) : itemID + idDelta;
+
+		if (itemID < MIN_int32 || itemID > MAX_int32)
+			return false;
+
+		outCountChanges.Add(TPair<int32, int32>((int32)itemID, UnZigZag(countChange)));
+	}
+
+	outFromVersion = (int32)fromVersion;
+	outToVersion = (int32)toVersion;
+	return offset == diff.Num();
+}
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Versioned log of count changes for one container, each change moves the version on by one.
+ * Entries are a zigzag varint item id and a zigzag varint signed count change, so a
+ * typical change costs 2-4 bytes. Diffs coalesce a version range into one net change per item.
+ *
+ * Diff layout: varint from version, varint to version, varint entry count, then entries sorted by
+ * item id. The first id is zigzag encoded, every later one is an unsigned varint step from the one before.
+ *
+ * History is capped at MaxHistory versions, older ones are compacted away as new changes come in
+ * and anyone further behind falls back to a snapshot.
+ */
+class SURVIVALGAME_API FContainerJournal
+{
+public:
+	static const int32 MaxHistory = 1024;
+
+	int32 GetVersion() const { return baseVersion + entryOffsets.Num(); }
+
+	// Diffs can start no earlier than this
+	int32 GetOldestVersion() const { return baseVersion; }
+
+	void Record(int32 itemID, int32 countChange);
+
+	// Net change between two versions, false if the range has been compacted away or is out of order
+	bool Diff(int32 fromVersion, int32 toVersion, TArray<uint8>& outDiff) const;
+
+	// Drops history before oldestVersion, e.g. once a save or client has acknowledged it
+	void Compact(int32 oldestVersion);
+
+	// Drops all history and continues from version
+	void Reset(int32 version);
+
+	static void EncodeDiff(int32 fromVersion, int32 toVersion, const TMap<int32, int32>& countChanges, TArray<uint8>& outDiff);
+	// Rejects anything EncodeDiff couldn't have written: ids not strictly increasing, zero changes, bad versions or trailing bytes
+	static bool DecodeDiff(const TArray<uint8>& diff, int32& outFromVersion, int32& outToVersion, TArray<TPair<int32, int32>>& outCountChanges);
+
+private:
+	int32 baseVersion = 0;
+	TArray<uint8> entries;
+
+	// Byte offset of the entry that produced version baseVersion + i + 1
+	TArray<int32> entryOffsets;
+};
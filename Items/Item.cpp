@@ -2,10 +2,102 @@
 
 
 #include "Item.h"
+#include "ItemPool.h"
+#include "UObject/UObjectIterator.h"
 
-UItem* UItem::CreateItem(int32 itemID, FItemSpecification inItemSpecification)
+namespace
 {
-	UItem* item = NewObject<UItem>();
-	item->SetItemSpecification(inItemSpecification);
+	// UItem as it was when every item held a copy of its spec, only measured, never constructed
+	class FLegacyItem : public UObject
+	{
+		FItemSpecification itemSpecification;
+	};
+}
+
+UItem* UItem::CreateItem(int32 itemID)
+{
+	UItem* item = UItemPool::GetInstance()->Acquire<UItem>();
+	item->SetItemID(FItemId(itemID));
 	return item;
 }
+
+void UItem::ReleaseItem(UItem* item)
+{
+	UItemPool::GetInstance()->Release(item);
+}
+
+void UItem::ResetInstanceState()
+{
+	SetItemID(FItemId());
+	quantity = 1;
+	quality = 0;
+	grade = 0;
+	durability = 1.0f;
+}
+
+const FItemSpecification* UItem::GetItemSpecification()
+{
+	const FSpecDatabase* specs = UDataTables::GetSpecs();
+
+	if (itemSpecification == nullptr || specGeneration != specs->GetGeneration()) {
+		itemSpecification = specs->GetItemSpecification(itemID);
+		specGeneration = specs->GetGeneration();
+	}
+
+	return itemSpecification;
+}
+
+FItemSpecification UItem::K2_GetItemSpecification()
+{
+	const FItemSpecification* itemSpec = GetItemSpecification();
+	return itemSpec != nullptr ? *itemSpec : FItemSpecification();
+}
+
+bool UItem::K2_SetItemSpecification(FItemSpecification val)
+{
+	const FSpecDatabase* specs = UDataTables::GetSpecs();
+	UScriptStruct* specStruct = FItemSpecification::StaticStruct();
+
+	for (const TPair<FItemId, const FItemSpecification*>& itemSpec : specs->GetItemsByID()) {
+		if (specStruct->CompareScriptStruct(itemSpec.Value, &val, PPF_None)) {
+			SetItemID(itemSpec.Key);
+			return true;
+		}
+	}
+
+	UE_LOG(LogTemp, Warning, TEXT("SetItemSpecification: no item row matches %s"), *val.name.ToString());
+	return false;
+}
+
+FString UItem::GetMemoryReport()
+{
+	int32 itemCount = 0;
+	SIZE_T instanceBytes = 0;
+	SIZE_T legacyBytes = 0;
+
+	// Both layouts measured past the UObject base, padding included, subclasses keep their own fields in either
+	const SIZE_T itemFieldBytes = sizeof(UItem) - sizeof(UObject);
+	const SIZE_T legacyFieldBytes = sizeof(FLegacyItem) - sizeof(UObject);
+
+	for (TObjectIterator<UItem> it; it; ++it) {
+		UItem* item = *it;
+
+		if (item->HasAnyFlags(RF_ClassDefaultObject))
+			continue;
+
+		SIZE_T itemBytes = item->GetClass()->GetStructureSize();
+		instanceBytes += itemBytes;
+		legacyBytes += itemBytes - itemFieldBytes + legacyFieldBytes;
+
+		itemCount++;
+	}
+
+	if (itemCount == 0)
+		return TEXT("No live items");
+
+	return FString::Printf(TEXT("%d items, %.1f bytes per item (was %.1f), %lld bytes saved"),
+		itemCount,
+		(double)instanceBytes / itemCount,
+		(double)legacyBytes / itemCount,
+		(int64)legacyBytes - (int64)instanceBytes);
+}
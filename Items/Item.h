@@ -8,7 +8,8 @@
 #include "Item.generated.h"
 
 /**
- * 
+ * Items share one immutable specification per item id through the spec database,
+ * only the state that differs between two items with the same id is stored inline.
  */
 UCLASS()
 class SURVIVALGAME_API UItem : public UObject
@@ -16,16 +17,76 @@ class SURVIVALGAME_API UItem : public UObject
 	GENERATED_BODY()
 
 private:
-	UPROPERTY(EditAnywhere, Category = "Item Specification")
-		FItemSpecification itemSpecification;
+	// Stable handle, the shared spec is re-resolved through it whenever the spec tables are swapped
+	FItemId itemID;
+	const FItemSpecification* itemSpecification;
+	uint32 specGeneration;
+
+	// Set while the item waits in UItemPool's free list, so releasing it twice is caught
+	friend class UItemPool;
+	bool pooled = false;
+
+	UPROPERTY(EditAnywhere, Category = "Item")
+		int32 quantity = 1;
+
+	UPROPERTY(EditAnywhere, Category = "Item")
+		uint8 quality = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Item")
+		uint8 grade = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Item")
+		float durability = 1.0f;
 
 public:
-	UFUNCTION(BlueprintCallable, Category = "Item Specification")
-		FItemSpecification GetItemSpecification() { return itemSpecification; }
+	const FItemSpecification* GetItemSpecification();
+
+	// Blueprint copy of the shared spec, default constructed when the id has none
+	UFUNCTION(BlueprintCallable, Category = "Item Specification", meta = (DisplayName = "Get Item Specification"))
+		FItemSpecification K2_GetItemSpecification();
+
+	// Specs are shared, so this adopts the id of the row equal to val. Returns false and keeps the id if there isn't one
+	UFUNCTION(BlueprintCallable, Category = "Item Specification", meta = (DisplayName = "Set Item Specification"))
+		bool K2_SetItemSpecification(FItemSpecification val);
+
+	FItemId GetItemID() { return itemID; }
+	virtual void SetItemID(FItemId val) { itemID = val; itemSpecification = nullptr; }
+
+	// Back to a freshly constructed state, called when the item is returned to the pool
+	virtual void ResetInstanceState();
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		int32 GetQuantity() { return quantity; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		void SetQuantity(int32 val) { quantity = val; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		uint8 GetQuality() { return quality; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		void SetQuality(uint8 val) { quality = val; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		uint8 GetGrade() { return grade; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		void SetGrade(uint8 val) { grade = val; }
 
-	UFUNCTION(BlueprintCallable, Category = "Item Specification")
-		void SetItemSpecification(FItemSpecification val) { itemSpecification = val; }
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		float GetDurability() { return durability; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		void SetDurability(float val) { durability = val; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		static UItem* CreateItem(int32 itemID);
+
+	// Hands the item back to UItemPool, which gives it to the next Acquire. Nothing may keep a reference to it afterwards
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		static void ReleaseItem(UItem* item);
 
+	// Compares bytes per live item against the old layout that embedded a copy of the spec
 	UFUNCTION(BlueprintCallable, Category = "Item")
-		static UItem* CreateItem(int32 itemID, FItemSpecification inItemSpecification);
+		static FString GetMemoryReport();
 };
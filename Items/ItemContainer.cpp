@@ -5,33 +5,492 @@
 #include "Item.h"
 #include "Weapon.h"
 #include "Armour/Armour.h"
+#include "ItemPool.h"
+#include "Algo/BinarySearch.h"
+#include "Async/Async.h"
 
 
-TArray<FItemSpecification*> UItemContainer::GetItemSpecifications()
+void UItemContainer::PostLoad()
 {
-	return UDataTables::GetInstance()->GetItems();
+	Super::PostLoad();
+
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+		RebuildIndexesOnGameThread();
+}
+
+void UItemContainer::PostDuplicate(bool bDuplicateForPIE)
+{
+	Super::PostDuplicate(bDuplicateForPIE);
+	RebuildIndexesOnGameThread();
+}
+
+void UItemContainer::RebuildIndexesOnGameThread()
+{
+	if (IsInGameThread()) {
+		RebuildIndexes();
+		return;
+	}
+
+	// PostLoad runs on the async loading thread while streaming, and UDataTables is game thread only
+	TWeakObjectPtr<UItemContainer> weakThis(this);
+
+	AsyncTask(ENamedThreads::GameThread, [weakThis]() {
+		if (UItemContainer* container = weakThis.Get())
+			container->RebuildIndexes();
+	});
+}
+
+void UItemContainer::RebuildIndexes()
+{
+	UDataTables* dataTables = UDataTables::GetInstance();
+
+	// Stack rules come from the specs, so rebuilding before they're indexed would drop every stack
+	if (!dataTables->IsReady()) {
+		dataTables->WhenReady(FSimpleDelegate::CreateUObject(this, &UItemContainer::RebuildIndexes));
+		return;
+	}
+
+	TMap<int32, int32> counts;
+
+	for (const FInventoryItem& stack : stacks) {
+		if (stack.quantity > 0)
+			counts.FindOrAdd(stack.itemID) += stack.quantity;
+	}
+
+	TArray<TPair<int32, int32>> itemCounts = counts.Array();
+	RestoreContents(itemCounts, journal.GetVersion());
+}
+
+TArrayView<const FItemSpecification* const> UItemContainer::GetItemSpecifications()
+{
+	return UDataTables::GetSpecs()->GetItems();
 }
 
 UItem* UItemContainer::LoadItem(int32 itemID)
 {
-	static const FString ContextString(TEXT("GENERAL"));
-	FName itemIDText = *FString::Printf(TEXT("%d"), itemID);
+	ensureMsgf(UDataTables::GetInstance()->IsReady(), TEXT("LoadItem before the tables are ready, wait on UDataTables::WhenReady"));
 
-	FItemSpecification* itemSpecification = UDataTables::GetInstance()->GetItemTable()->FindRow<FItemSpecification>(
-		itemIDText, ContextString);
+	const FItemSpecification* itemSpecification = UDataTables::GetSpecs()->GetItemSpecification(FItemId(itemID));
 
 	if (itemSpecification) {
 		switch (itemSpecification->itemType) {
 		case EItemType::NORMAL:
-			return UItem::CreateItem(itemID, *itemSpecification);
+			return UItem::CreateItem(itemID);
 		case EItemType::WEAPON:
-			return UWeapon::CreateWeapon(itemID, *itemSpecification);
+			return UWeapon::CreateWeapon(itemID);
 		case EItemType::ARMOUR:
-			return UArmour::CreateArmour(itemID, *itemSpecification);
+			return UArmour::CreateArmour(itemID);
 		default:
 			break;
 		}
 	}
 
 	return nullptr;
-}
\ No newline at end of file
+}
+
+TArray<UItem*> UItemContainer::LoadItems(TArrayView<const int32> itemIDs)
+{
+	ensureMsgf(UDataTables::GetInstance()->IsReady(), TEXT("LoadItems before the tables are ready, wait on UDataTables::WhenReady"));
+
+	// One snapshot for the whole batch, so every id resolves against the same tables
+	const FSpecDatabase* specs = UDataTables::GetSpecs();
+
+	TArray<UItem*> loaded;
+	loaded.SetNumZeroed(itemIDs.Num());
+
+	// Input slots grouped by the class they load as
+	TArray<int32> normalSlots;
+	TArray<int32> weaponSlots;
+	TArray<int32> armourSlots;
+
+	for (int32 i = 0; i < itemIDs.Num(); i++) {
+		const FItemSpecification* itemSpecification = specs->GetItemSpecification(FItemId(itemIDs[i]));
+
+		if (itemSpecification == nullptr)
+			continue;
+
+		switch (itemSpecification->itemType) {
+		case EItemType::NORMAL:
+			normalSlots.Add(i);
+			break;
+		case EItemType::WEAPON: {
+			// Only plain weapons have a class yet, matching CreateWeapon
+			const FWeaponSpecification* weaponSpec = specs->GetWeaponSpecification(FItemId(itemIDs[i]));
+
+			if (weaponSpec != nullptr && weaponSpec->weaponType == EWeaponType::NORMAL)
+				weaponSlots.Add(i);
+			break;
+		}
+		case EItemType::ARMOUR:
+			armourSlots.Add(i);
+			break;
+		default:
+			break;
+		}
+	}
+
+	UItemPool* pool = UItemPool::GetInstance();
+	TArray<UItem*> batch;
+
+	auto fillSlots = [&](TSubclassOf<UItem> itemClass, const TArray<int32>& slots) {
+		batch.Reset();
+		pool->AcquireBatch(itemClass, slots.Num(), batch);
+
+		for (int32 i = 0; i < slots.Num(); i++) {
+			batch[i]->SetItemID(FItemId(itemIDs[slots[i]]));
+			loaded[slots[i]] = batch[i];
+		}
+	};
+
+	fillSlots(UItem::StaticClass(), normalSlots);
+	fillSlots(UWeapon::StaticClass(), weaponSlots);
+	fillSlots(UArmour::StaticClass(), armourSlots);
+
+	return loaded;
+}
+
+bool UItemContainer::GetStackRules(int32 itemID, int32& stackLimit, float& weight, EItemType& itemType) const
+{
+	const FItemStackInfo* info = stackInfoByItemID.Find(itemID);
+
+	if (info != nullptr) {
+		stackLimit = info->stackLimit;
+		weight = info->weight;
+		itemType = info->itemType;
+		return true;
+	}
+
+	const FItemSpecification* itemSpecification = UDataTables::GetSpecs()->GetItemSpecification(FItemId(itemID));
+
+	if (itemSpecification == nullptr)
+		return false;
+
+	stackLimit = FMath::Max(itemSpecification->stackLimit, 1);
+	weight = itemSpecification->weight;
+	itemType = itemSpecification->itemType;
+	return true;
+}
+
+bool UItemContainer::GetAddCost(int32 itemID, int32 amount, int32& outNewStacks, float& outWeight) const
+{
+	int32 stackLimit;
+	float weight;
+	EItemType itemType;
+
+	if (amount <= 0 || !GetStackRules(itemID, stackLimit, weight, itemType))
+		return false;
+
+	const FItemStackInfo* info = stackInfoByItemID.Find(itemID);
+	int32 overflow = amount - (info != nullptr ? info->GetFreeSpace() : 0);
+
+	outNewStacks = overflow > 0 ? FMath::DivideAndRoundUp(overflow, stackLimit) : 0;
+	outWeight = weight * amount;
+	return true;
+}
+
+bool UItemContainer::FitsWithin(int32 newStacks, float addedWeight) const
+{
+	if (maxWeight > 0 && totalWeight + addedWeight > maxWeight)
+		return false;
+
+	return maxStacks == INDEX_NONE || stacks.Num() + newStacks <= maxStacks;
+}
+
+bool UItemContainer::CanAdd(int32 itemID, int32 amount)
+{
+	int32 newStacks;
+	float addedWeight;
+
+	return GetAddCost(itemID, amount, newStacks, addedWeight) && FitsWithin(newStacks, addedWeight);
+}
+
+bool UItemContainer::TransferItems(UItemContainer* target, const TArray<FInventoryItem>& moves)
+{
+	if (target == nullptr || target == this)
+		return false;
+
+	// Repeated ids are merged so each item is validated and applied once
+	TMap<int32, int32> amounts;
+	amounts.Reserve(moves.Num());
+
+	for (const FInventoryItem& move : moves) {
+		if (move.quantity <= 0)
+			return false;
+
+		amounts.FindOrAdd(move.itemID) += move.quantity;
+	}
+
+	// Validate the whole set against both sides before anything changes, so a failed
+	// transfer never needs rolling back
+	int32 newStacks = 0;
+	float addedWeight = 0;
+
+	for (const TPair<int32, int32>& amount : amounts) {
+		int32 itemStacks;
+		float itemWeight;
+
+		if (GetItemCount(amount.Key) < amount.Value || !target->GetAddCost(amount.Key, amount.Value, itemStacks, itemWeight))
+			return false;
+
+		newStacks += itemStacks;
+		addedWeight += itemWeight;
+	}
+
+	if (!target->FitsWithin(newStacks, addedWeight))
+		return false;
+
+	// One growth for the target, the source only shrinks in place
+	target->stacks.Reserve(target->stacks.Num() + newStacks);
+	target->itemsByWeight.Reserve(target->itemsByWeight.Num() + amounts.Num());
+
+	for (const TPair<int32, int32>& amount : amounts) {
+		RemoveStacks(amount.Key, amount.Value);
+		journal.Record(amount.Key, -amount.Value);
+
+		target->AddStacks(amount.Key, amount.Value);
+		target->journal.Record(amount.Key, amount.Value);
+	}
+
+	return true;
+}
+
+bool UItemContainer::AddItem(int32 itemID, int32 amount)
+{
+	if (!CanAdd(itemID, amount))
+		return false;
+
+	AddStacks(itemID, amount);
+	journal.Record(itemID, amount);
+	return true;
+}
+
+bool UItemContainer::RemoveItem(int32 itemID, int32 amount)
+{
+	if (amount <= 0 || GetItemCount(itemID) < amount)
+		return false;
+
+	RemoveStacks(itemID, amount);
+	journal.Record(itemID, -amount);
+	return true;
+}
+
+void UItemContainer::GetItemCounts(TArray<TPair<int32, int32>>& outItemCounts) const
+{
+	outItemCounts.Reserve(outItemCounts.Num() + stackInfoByItemID.Num());
+
+	for (const TPair<int32, FItemStackInfo>& info : stackInfoByItemID) {
+		outItemCounts.Add(TPair<int32, int32>(info.Key, info.Value.count));
+	}
+}
+
+void UItemContainer::RestoreContents(TArrayView<const TPair<int32, int32>> itemCounts, int32 version)
+{
+	stacks.Reset();
+	stackInfoByItemID.Reset();
+	itemIDsByType.Reset();
+	itemsByWeight.Reset();
+	totalWeight = 0;
+
+	for (const TPair<int32, int32>& itemCount : itemCounts) {
+		int32 stackLimit;
+		float weight;
+		EItemType itemType;
+
+		if (itemCount.Value > 0 && GetStackRules(itemCount.Key, stackLimit, weight, itemType))
+			AddStacks(itemCount.Key, itemCount.Value);
+	}
+
+	journal.Reset(version);
+}
+
+void UItemContainer::AddStacks(int32 itemID, int32 amount)
+{
+	FItemStackInfo* info = stackInfoByItemID.Find(itemID);
+
+	if (info == nullptr) {
+		info = &stackInfoByItemID.Add(itemID);
+		GetStackRules(itemID, info->stackLimit, info->weight, info->itemType);
+		itemIDsByType.FindOrAdd(info->itemType).Add(itemID);
+	}
+
+	info->count += amount;
+	totalWeight += info->weight * amount;
+	ReindexWeight(itemID, *info);
+
+	int32 remaining = amount;
+
+	if (info->stackIndexes.Num() > 0) {
+		FInventoryItem& partial = stacks[info->stackIndexes.Last()];
+		int32 added = FMath::Min(remaining, info->stackLimit - partial.quantity);
+		partial.quantity += added;
+		remaining -= added;
+	}
+
+	while (remaining > 0) {
+		FInventoryItem& stack = stacks[stacks.AddZeroed()];
+		stack.itemID = itemID;
+		stack.quantity = FMath::Min(remaining, info->stackLimit);
+		remaining -= stack.quantity;
+		info->stackIndexes.Add(stacks.Num() - 1);
+	}
+}
+
+void UItemContainer::RemoveStacks(int32 itemID, int32 amount)
+{
+	FItemStackInfo* info = &stackInfoByItemID.FindChecked(itemID);
+
+	info->count -= amount;
+	totalWeight -= info->weight * amount;
+	ReindexWeight(itemID, *info);
+
+	int32 remaining = amount;
+
+	while (remaining > 0) {
+		int32 stackIndex = info->stackIndexes.Last();
+		FInventoryItem& stack = stacks[stackIndex];
+		int32 taken = FMath::Min(remaining, stack.quantity);
+		stack.quantity -= taken;
+		remaining -= taken;
+
+		if (stack.quantity == 0) {
+			info->stackIndexes.Pop(false);
+			RemoveStack(stackIndex);
+		}
+	}
+
+	if (info->count == 0) {
+		itemIDsByType.FindChecked(info->itemType).Remove(itemID);
+		stackInfoByItemID.Remove(itemID);
+	}
+
+	// Nothing left to drift against
+	if (stacks.Num() == 0)
+		totalWeight = 0;
+}
+
+bool UItemContainer::GetDiff(int32 fromVersion, TArray<uint8>& outDiff) const
+{
+	return journal.Diff(fromVersion, journal.GetVersion(), outDiff);
+}
+
+TArray<uint8> UItemContainer::GetSnapshot() const
+{
+	TMap<int32, int32> counts;
+	counts.Reserve(stackInfoByItemID.Num());
+
+	for (const TPair<int32, FItemStackInfo>& info : stackInfoByItemID) {
+		counts.Add(info.Key, info.Value.count);
+	}
+
+	TArray<uint8> snapshot;
+	FContainerJournal::EncodeDiff(0, journal.GetVersion(), counts, snapshot);
+	return snapshot;
+}
+
+bool UItemContainer::ApplyDiff(const TArray<uint8>& diff)
+{
+	int32 fromVersion;
+	int32 toVersion;
+	TArray<TPair<int32, int32>> countChanges;
+
+	if (!FContainerJournal::DecodeDiff(diff, fromVersion, toVersion, countChanges) || fromVersion != journal.GetVersion())
+		return false;
+
+	// Validate everything first so a bad diff leaves the container untouched
+	int64 stacksAfter = stacks.Num();
+
+	for (const TPair<int32, int32>& countChange : countChanges) {
+		int32 stackLimit;
+		float weight;
+		EItemType itemType;
+
+		// Held items always have rules, so this only fails for adds of unknown items
+		if (!GetStackRules(countChange.Key, stackLimit, weight, itemType))
+			return false;
+
+		// FItemStackInfo::count is an int32 and can't go negative
+		int64 countAfter = (int64)GetItemCount(countChange.Key) + countChange.Value;
+
+		if (countAfter < 0 || countAfter > MAX_int32)
+			return false;
+
+		const FItemStackInfo* info = stackInfoByItemID.Find(countChange.Key);
+		stacksAfter += FMath::DivideAndRoundUp(countAfter, (int64)stackLimit) - (info != nullptr ? info->stackIndexes.Num() : 0);
+	}
+
+	// The diff is authoritative, so it skips the weight limit that AddItem enforces. Stacks are still capped at the
+	// container's limit, or MaxDiffStacks without one, so a hostile count can't make AddStacks allocate without bound
+	int64 maxStacksAfter = FMath::Max<int64>(maxStacks != INDEX_NONE ? maxStacks : MaxDiffStacks, stacks.Num());
+
+	if (stacksAfter > maxStacksAfter)
+		return false;
+
+	for (const TPair<int32, int32>& countChange : countChanges) {
+		if (countChange.Value < 0)
+			RemoveStacks(countChange.Key, -countChange.Value);
+		else
+			AddStacks(countChange.Key, countChange.Value);
+	}
+
+	// The source holds the history in between, this side only needs to carry on from its version
+	journal.Reset(toVersion);
+	return true;
+}
+
+int32 UItemContainer::GetItemCount(int32 itemID) const
+{
+	const FItemStackInfo* info = stackInfoByItemID.Find(itemID);
+	return info != nullptr ? info->count : 0;
+}
+
+TArray<int32> UItemContainer::GetItemIDsOfType(EItemType itemType) const
+{
+	const TSet<int32>* itemIDs = itemIDsByType.Find(itemType);
+	return itemIDs != nullptr ? itemIDs->Array() : TArray<int32>();
+}
+
+TArray<int32> UItemContainer::GetHeaviestItems(int32 count) const
+{
+	TArray<int32> heaviest;
+	int32 num = FMath::Clamp(count, 0, itemsByWeight.Num());
+	heaviest.Reserve(num);
+
+	for (int32 i = itemsByWeight.Num() - 1; i >= itemsByWeight.Num() - num; i--) {
+		heaviest.Add(itemsByWeight[i].itemID);
+	}
+
+	return heaviest;
+}
+
+void UItemContainer::ReindexWeight(int32 itemID, FItemStackInfo& info)
+{
+	// Items already in the view are found by the exact key they were placed with
+	if (itemsByWeight.Num() > 0) {
+		FItemWeightEntry oldEntry = { info.indexedWeight, itemID };
+		int32 oldIndex = Algo::LowerBound(itemsByWeight, oldEntry);
+
+		if (oldIndex < itemsByWeight.Num() && itemsByWeight[oldIndex].itemID == itemID)
+			itemsByWeight.RemoveAt(oldIndex, 1, false);
+	}
+
+	if (info.count == 0)
+		return;
+
+	info.indexedWeight = info.weight * info.count;
+
+	FItemWeightEntry newEntry = { info.indexedWeight, itemID };
+	itemsByWeight.Insert(newEntry, Algo::LowerBound(itemsByWeight, newEntry));
+}
+
+void UItemContainer::RemoveStack(int32 stackIndex)
+{
+	int32 lastIndex = stacks.Num() - 1;
+
+	// The last stack moves into the gap, so point its owner at the new slot
+	if (stackIndex != lastIndex) {
+		FItemStackInfo& movedInfo = stackInfoByItemID.FindChecked(stacks[lastIndex].itemID);
+		movedInfo.stackIndexes[movedInfo.stackIndexes.Find(lastIndex)] = stackIndex;
+	}
+
+	stacks.RemoveAtSwap(stackIndex, 1, false);
+}
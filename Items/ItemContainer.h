@@ -5,25 +5,178 @@
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
 #include "../Datatables/DataTables.h"
+#include "ContainerJournal.h"
 #include "ItemContainer.generated.h"
 
 class UItem;
 
+// Running totals for one item id, kept in step with its stacks
+struct FItemStackInfo
+{
+	int32 count = 0;
+	int32 stackLimit = 1;
+	float weight = 0;
+	EItemType itemType = EItemType::NORMAL;
+
+	// Key this item currently has in the weight view, count * weight when it was last placed
+	float indexedWeight = 0;
+
+	// Every stack but the last is full, so the last one is the only one with room
+	TArray<int32> stackIndexes;
+
+	int32 GetFreeSpace() const { return stackIndexes.Num() * stackLimit - count; }
+};
+
+// Entry in the container's weight ordered view of its item ids
+struct FItemWeightEntry
+{
+	float weight;
+	int32 itemID;
+
+	bool operator<(const FItemWeightEntry& other) const
+	{
+		return weight < other.weight || (weight == other.weight && itemID < other.itemID);
+	}
+};
+
 /**
- * 
+ * Items are held as stacks that respect each item's stack limit.
+ * Counts, stack usage and weight are updated as items are added and removed,
+ * so capacity and encumbrance checks never rescan the container.
  */
 UCLASS()
 class SURVIVALGAME_API UItemContainer : public UObject
 {
 	GENERATED_BODY()
 public:
-	TArray<FItemSpecification*> GetItemSpecifications();
+	// stacks is the only serialized state, the indexes over it are rebuilt after a load or duplicate
+	virtual void PostLoad() override;
+	virtual void PostDuplicate(bool bDuplicateForPIE) override;
+
+	TArrayView<const FItemSpecification* const> GetItemSpecifications();
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		const TArray<FInventoryItem>& GetStacks() const { return stacks; }
+
+	// Whether all of amount fits, both in free stacks and under the weight limit
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		bool CanAdd(int32 itemID, int32 amount);
+
+	// All or nothing, tops up the item's partial stack before opening new ones
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		bool AddItem(int32 itemID, int32 amount);
+
+	// All or nothing, takes from the item's partial stack first
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		bool RemoveItem(int32 itemID, int32 amount);
+
+	// Moves every (itemID, quantity) in moves to target, validated as one set so either all of it moves or none does
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		bool TransferItems(UItemContainer* target, const TArray<FInventoryItem>& moves);
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		int32 GetItemCount(int32 itemID) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		bool HasItem(int32 itemID) const { return stackInfoByItemID.Contains(itemID); }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		TArray<int32> GetItemIDsOfType(EItemType itemType) const;
+
+	// Up to count item ids, heaviest total weight first
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		TArray<int32> GetHeaviestItems(int32 count) const;
+
+	// Every held item id, lightest total weight first
+	const TArray<FItemWeightEntry>& GetItemsByWeight() const { return itemsByWeight; }
 
 	UFUNCTION(BlueprintCallable, Category = "Item")
-		TArray<int32>& GetItems() { return items; }
+		float GetTotalWeight() const { return totalWeight; }
 
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		int32 GetMaxStacks() const { return maxStacks; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		void SetMaxStacks(int32 val) { maxStacks = val; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		float GetMaxWeight() const { return maxWeight; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		void SetMaxWeight(float val) { maxWeight = val; }
+
+	// Every successful add or remove moves the version on by one
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		int32 GetVersion() const { return journal.GetVersion(); }
+
+	// Net changes from fromVersion to now, false if that version has been compacted away
+	bool GetDiff(int32 fromVersion, TArray<uint8>& outDiff) const;
+
+	// Whole contents as a diff from version 0, for saves and clients with no usable base
+	TArray<uint8> GetSnapshot() const;
+
+	// Most stacks an ApplyDiff can leave a container with no stack limit holding
+	static const int32 MaxDiffStacks = 65536;
+
+	// Applies a diff taken from this container's current version, all or nothing
+	bool ApplyDiff(const TArray<uint8>& diff);
+
+	// Appends one (itemID, count) pair per held item
+	void GetItemCounts(TArray<TPair<int32, int32>>& outItemCounts) const;
+
+	// Replaces the whole contents with (itemID, count) pairs and carries on from version, for loading saves.
+	// Like ApplyDiff it skips the capacity limits, ids with no spec are dropped
+	void RestoreContents(TArrayView<const TPair<int32, int32>> itemCounts, int32 version);
+
+	// Forgets history before oldestVersion once every save or client has moved past it
+	void CompactJournal(int32 oldestVersion) { journal.Compact(oldestVersion); }
+
+	// The tables must be ready, callers go through UDataTables::WhenReady first. Ids resolve to nullptr until then
 	static UItem* LoadItem(int32 itemID);
 
+	// One spec pass and one pool batch per item class, results line up with itemIDs, nullptr where an id has no item
+	static TArray<UItem*> LoadItems(TArrayView<const int32> itemIDs);
+
 private:
-	TArray<int32> items;
+	UPROPERTY()
+		TArray<FInventoryItem> stacks;
+
+	// INDEX_NONE for no limit
+	UPROPERTY(EditAnywhere, Category = "Item")
+		int32 maxStacks = INDEX_NONE;
+
+	// Zero or less for no limit
+	UPROPERTY(EditAnywhere, Category = "Item")
+		float maxWeight = 0;
+
+	float totalWeight = 0;
+
+	// Also the item id index, an item has an entry exactly while the container holds some of it
+	TMap<int32, FItemStackInfo> stackInfoByItemID;
+	TMap<EItemType, TSet<int32>> itemIDsByType;
+	TArray<FItemWeightEntry> itemsByWeight;
+	FContainerJournal journal;
+
+	// Regroups stacks by their stack limits and rebuilds every index from them, waits for the tables if they aren't ready.
+	// Game thread only
+	void RebuildIndexes();
+
+	// RebuildIndexes now on the game thread, queued for it from any other
+	void RebuildIndexesOnGameThread();
+
+	// Stack limit, unit weight and type for itemID, false for items with no spec
+	bool GetStackRules(int32 itemID, int32& stackLimit, float& weight, EItemType& itemType) const;
+
+	// New stacks and weight adding amount of itemID would take, false for unknown items or a non-positive amount
+	bool GetAddCost(int32 itemID, int32 amount, int32& outNewStacks, float& outWeight) const;
+	bool FitsWithin(int32 newStacks, float addedWeight) const;
+
+	// Stack bookkeeping shared by the checked API, transfers and ApplyDiff, callers have already validated amount
+	void AddStacks(int32 itemID, int32 amount);
+	void RemoveStacks(int32 itemID, int32 amount);
+
+	// Moves itemID to the weight view slot for its current count, or out of it when the count is zero
+	void ReindexWeight(int32 itemID, FItemStackInfo& info);
+
+	void RemoveStack(int32 stackIndex);
 };
@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ItemPool.h"
+#include "Item.h"
+
+UItemPool* UItemPool::INSTANCE;
+
+void UItemPool::BeginDestroy()
+{
+	if (this == INSTANCE)
+		INSTANCE = nullptr;
+
+	Super::BeginDestroy();
+}
+
+UItemPool* UItemPool::GetInstance()
+{
+	if (INSTANCE == nullptr)
+	{
+		check(IsInGameThread());
+
+		INSTANCE = NewObject<UItemPool>();
+		INSTANCE->AddToRoot();
+	}
+
+	return INSTANCE;
+}
+
+UItem* UItemPool::Acquire(TSubclassOf<UItem> itemClass)
+{
+	check(IsInGameThread());
+
+	if (itemClass == nullptr)
+		return nullptr;
+
+	FItemPoolBucket& bucket = buckets.FindOrAdd(itemClass.Get());
+	UItem* item = nullptr;
+
+	if (bucket.freeItems.Num() > 0) {
+		item = bucket.freeItems.Pop(false);
+		item->pooled = false;
+		bucket.stats.hits++;
+	}
+	else {
+		item = NewObject<UItem>(GetTransientPackage(), itemClass);
+		bucket.stats.misses++;
+	}
+
+	bucket.stats.live++;
+	bucket.stats.liveHighWater = FMath::Max(bucket.stats.liveHighWater, bucket.stats.live);
+	return item;
+}
+
+void UItemPool::AcquireBatch(TSubclassOf<UItem> itemClass, int32 count, TArray<UItem*>& outItems)
+{
+	check(IsInGameThread());
+
+	if (itemClass == nullptr || count <= 0)
+		return;
+
+	FItemPoolBucket& bucket = buckets.FindOrAdd(itemClass.Get());
+	int32 reused = FMath::Min(count, bucket.freeItems.Num());
+	int32 firstFree = bucket.freeItems.Num() - reused;
+
+	outItems.Reserve(outItems.Num() + count);
+	outItems.Append(bucket.freeItems.GetData() + firstFree, reused);
+	bucket.freeItems.SetNum(firstFree, false);
+
+	for (int32 i = outItems.Num() - reused; i < outItems.Num(); i++) {
+		outItems[i]->pooled = false;
+	}
+
+	for (int32 i = reused; i < count; i++) {
+		outItems.Add(NewObject<UItem>(GetTransientPackage(), itemClass));
+	}
+
+	bucket.stats.hits += reused;
+	bucket.stats.misses += count - reused;
+	bucket.stats.live += count;
+	bucket.stats.liveHighWater = FMath::Max(bucket.stats.liveHighWater, bucket.stats.live);
+}
+
+void UItemPool::Release(UItem* item)
+{
+	check(IsInGameThread());
+
+	if (item == nullptr || item->IsPendingKill())
+		return;
+
+	// Parking it twice would hand the same object to two owners, so a second release is dropped in every build
+	if (!ensureMsgf(!item->pooled, TEXT("%s released to the item pool twice"), *item->GetName()))
+		return;
+
+	FItemPoolBucket& bucket = buckets.FindOrAdd(item->GetClass());
+
+	// Items created outside the pool can be released into it too
+	bucket.stats.live = FMath::Max(bucket.stats.live - 1, 0);
+
+	if (bucket.freeItems.Num() >= maxFreePerClass)
+		return;
+
+	item->ResetInstanceState();
+	item->pooled = true;
+	bucket.freeItems.Add(item);
+	bucket.stats.freeHighWater = FMath::Max(bucket.stats.freeHighWater, bucket.freeItems.Num());
+}
+
+FItemPoolStats UItemPool::GetStats(TSubclassOf<UItem> itemClass) const
+{
+	const FItemPoolBucket* bucket = buckets.Find(itemClass.Get());
+	return bucket != nullptr ? bucket->stats : FItemPoolStats();
+}
+
+FItemPoolStats UItemPool::GetTotalStats() const
+{
+	FItemPoolStats total;
+
+	for (const TPair<UClass*, FItemPoolBucket>& bucket : buckets) {
+		total.hits += bucket.Value.stats.hits;
+		total.misses += bucket.Value.stats.misses;
+		total.live += bucket.Value.stats.live;
+		total.liveHighWater += bucket.Value.stats.liveHighWater;
+		total.freeHighWater += bucket.Value.stats.freeHighWater;
+	}
+
+	return total;
+}
+
+void UItemPool::Trim(int32 maxFree)
+{
+	for (TPair<UClass*, FItemPoolBucket>& bucket : buckets) {
+		if (bucket.Value.freeItems.Num() > maxFree)
+			bucket.Value.freeItems.SetNum(FMath::Max(maxFree, 0));
+	}
+}
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Templates/SubclassOf.h"
+#include "ItemPool.generated.h"
+
+class UItem;
+
+USTRUCT(BlueprintType)
+struct FItemPoolStats
+{
+	GENERATED_USTRUCT_BODY()
+public:
+	// Acquires served from the free list
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Item Pool")
+		int32 hits = 0;
+
+	// Acquires that had to construct a new object
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Item Pool")
+		int32 misses = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Item Pool")
+		int32 live = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Item Pool")
+		int32 liveHighWater = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Item Pool")
+		int32 freeHighWater = 0;
+};
+
+USTRUCT()
+struct FItemPoolBucket
+{
+	GENERATED_USTRUCT_BODY()
+public:
+	UPROPERTY()
+		TArray<UItem*> freeItems;
+
+	UPROPERTY()
+		FItemPoolStats stats;
+};
+
+/**
+ * Recycles released items by exact class so loot churn doesn't turn into UObject garbage.
+ * Free items are held by this rooted pool, so they are never collected while waiting for reuse.
+ * Game thread only, like NewObject.
+ */
+UCLASS()
+class SURVIVALGAME_API UItemPool : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void BeginDestroy() override;
+
+	static UItemPool* GetInstance();
+
+	template<typename T>
+	T* Acquire() { return CastChecked<T>(Acquire(T::StaticClass())); }
+
+	UFUNCTION(BlueprintCallable, Category = "Item Pool")
+		UItem* Acquire(TSubclassOf<UItem> itemClass);
+
+	// Appends count items of itemClass to outItems, free ones first, then one bulk construction pass
+	void AcquireBatch(TSubclassOf<UItem> itemClass, int32 count, TArray<UItem*>& outItems);
+
+	// Resets the item's instance state and parks it for reuse, the caller must drop every reference to it
+	UFUNCTION(BlueprintCallable, Category = "Item Pool")
+		void Release(UItem* item);
+
+	UFUNCTION(BlueprintCallable, Category = "Item Pool")
+		FItemPoolStats GetStats(TSubclassOf<UItem> itemClass) const;
+
+	// Summed over every class
+	UFUNCTION(BlueprintCallable, Category = "Item Pool")
+		FItemPoolStats GetTotalStats() const;
+
+	// Drops free items above maxFree per class and lets GC have them
+	UFUNCTION(BlueprintCallable, Category = "Item Pool")
+		void Trim(int32 maxFree);
+
+	UFUNCTION(BlueprintCallable, Category = "Item Pool")
+		int32 GetMaxFreePerClass() const { return maxFreePerClass; }
+
+	UFUNCTION(BlueprintCallable, Category = "Item Pool")
+		void SetMaxFreePerClass(int32 val) { maxFreePerClass = val; Trim(val); }
+
+private:
+	static UItemPool* INSTANCE;
+
+	UPROPERTY()
+		TMap<UClass*, FItemPoolBucket> buckets;
+
+	// Released items past this are left for GC instead of being kept
+	UPROPERTY(EditAnywhere, Category = "Item Pool")
+		int32 maxFreePerClass = 1024;
+};
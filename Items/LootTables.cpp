@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LootTables.h"
+#include "ItemContainer.h"
+
+void FAliasTable::Build(TArrayView<const float> weights)
+{
+	int32 num = weights.Num();
+	probabilities.SetNumUninitialized(num);
+	aliases.SetNumUninitialized(num);
+
+	float total = 0;
+
+	for (float weight : weights) {
+		total += FMath::Max(weight, 0.0f);
+	}
+
+	if (num == 0 || total <= 0) {
+		probabilities.Reset();
+		aliases.Reset();
+		return;
+	}
+
+	// Scale so the average column holds exactly 1, then pair each short column with a tall one
+	TArray<float> scaled;
+	TArray<int32> small;
+	TArray<int32> large;
+	scaled.SetNumUninitialized(num);
+	small.Reserve(num);
+	large.Reserve(num);
+
+	for (int32 i = 0; i < num; i++) {
+		scaled[i] = FMath::Max(weights[i], 0.0f) * num / total;
+		(scaled[i] < 1.0f ? small : large).Add(i);
+	}
+
+	while (small.Num() > 0 && large.Num() > 0) {
+		int32 shortColumn = small.Pop(false);
+		int32 tallColumn = large.Last();
+
+		probabilities[shortColumn] = scaled[shortColumn];
+		aliases[shortColumn] = tallColumn;
+
+		scaled[tallColumn] -= 1.0f - scaled[shortColumn];
+
+		if (scaled[tallColumn] < 1.0f) {
+			large.Pop(false);
+			small.Add(tallColumn);
+		}
+	}
+
+	// Whatever is left is 1 up to rounding
+	for (int32 column : large) {
+		probabilities[column] = 1.0f;
+		aliases[column] = column;
+	}
+	for (int32 column : small) {
+		probabilities[column] = 1.0f;
+		aliases[column] = column;
+	}
+}
+
+FLootTables::FLootTables(const FSpecDatabaseRef& snapshot)
+	: specs(snapshot)
+	, generation(snapshot->GetGeneration())
+{
+	for (const FLootEntry* entry : specs->GetLootEntries()) {
+		// Drops of items with no spec could never be added to a container
+		if (entry->weight > 0 && specs->GetItemSpecification(FItemId(entry->itemID)) != nullptr)
+			tablesByID.FindOrAdd(entry->lootTableID).entries.Add(entry);
+	}
+
+	TArray<float> weights;
+
+	for (TPair<int32, FTable>& table : tablesByID) {
+		weights.Reset();
+
+		for (const FLootEntry* entry : table.Value.entries) {
+			weights.Add(entry->weight);
+		}
+
+		table.Value.alias.Build(weights);
+	}
+}
+
+TSharedRef<const FLootTables, ESPMode::ThreadSafe> FLootTables::Get()
+{
+	check(IsInGameThread());
+
+	static TSharedPtr<const FLootTables, ESPMode::ThreadSafe> Cached;
+
+	if (!Cached.IsValid() || Cached->GetGeneration() != UDataTables::GetSpecs()->GetGeneration())
+		Cached = MakeShared<const FLootTables, ESPMode::ThreadSafe>(UDataTables::AcquireSpecs());
+
+	return Cached.ToSharedRef();
+}
+
+bool FLootTables::Roll(int32 lootTableID, int32 drops, FLootRandom& random, TArray<FInventoryItem>& outItems) const
+{
+	const FTable* table = tablesByID.Find(lootTableID);
+
+	if (table == nullptr || table->alias.Num() == 0)
+		return false;
+
+	outItems.Reserve(outItems.Num() + drops);
+
+	for (int32 i = 0; i < drops; i++) {
+		const FLootEntry* entry = table->entries[table->alias.Sample(random)];
+
+		FInventoryItem& item = outItems.AddDefaulted_GetRef();
+		item.itemID = entry->itemID;
+		item.quantity = FMath::Max(random.RandRange(entry->minQuantity, entry->maxQuantity), 1);
+		item.quality = random.RandRange(entry->minQuality, entry->maxQuality);
+		item.grade = random.RandRange(entry->minGrade, entry->maxGrade);
+	}
+
+	return true;
+}
+
+int32 FLootTables::Fill(UItemContainer* container, int32 lootTableID, int32 drops, FLootRandom& random) const
+{
+	TArray<FInventoryItem> rolled;
+
+	if (container == nullptr || !Roll(lootTableID, drops, random, rolled))
+		return 0;
+
+	int32 added = 0;
+
+	for (const FInventoryItem& item : rolled) {
+		if (container->AddItem(item.itemID, item.quantity))
+			added++;
+	}
+
+	return added;
+}
+
+double FLootTables::BenchmarkDraws(int32 tableSize, int32 draws)
+{
+	FLootRandom random(12345);
+	TArray<float> weights;
+	weights.SetNumUninitialized(tableSize);
+
+	for (float& weight : weights) {
+		weight = 0.01f + random.NextFloat() * 100.0f;
+	}
+
+	FAliasTable alias;
+	alias.Build(weights);
+
+	// Summed so the draws can't be optimised away
+	int64 checksum = 0;
+	double start = FPlatformTime::Seconds();
+
+	for (int32 i = 0; i < draws; i++) {
+		checksum += alias.Sample(random);
+	}
+
+	double seconds = FPlatformTime::Seconds() - start;
+	UE_LOG(LogTemp, Log, TEXT("Loot: %d draws from %d entries in %.3f ms (checksum %lld)"), draws, tableSize, seconds * 1000.0, checksum);
+
+	return seconds > 0 ? draws / seconds : 0;
+}
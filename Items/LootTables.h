@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "../Datatables/DataTables.h"
+
+class UItemContainer;
+
+/**
+ * Small, fast, seedable generator (xorshift64*), so a region seeded the same way always rolls the same loot.
+ * Not shared between threads, give each worker its own.
+ */
+struct FLootRandom
+{
+	uint64 state;
+
+	explicit FLootRandom(uint64 seed) : state(seed != 0 ? seed : 0x9E3779B97F4A7C15ull) {}
+
+	uint32 Next()
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return (uint32)((state * 0x2545F4914F6CDD1Dull) >> 32);
+	}
+
+	// [0, 1)
+	float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+	// [0, num)
+	int32 NextIndex(int32 num) { return (int32)(((uint64)Next() * (uint32)num) >> 32); }
+
+	// [min, max], max below min is treated as min
+	int32 RandRange(int32 min, int32 max) { return max > min ? min + NextIndex(max - min + 1) : min; }
+};
+
+/**
+ * Walker/Vose alias table, draws from a weighted distribution in O(1) with one index and one float roll.
+ * Building is O(n).
+ */
+class SURVIVALGAME_API FAliasTable
+{
+public:
+	void Build(TArrayView<const float> weights);
+
+	// INDEX_NONE when the table is empty
+	int32 Sample(FLootRandom& random) const
+	{
+		if (probabilities.Num() == 0)
+			return INDEX_NONE;
+
+		int32 column = random.NextIndex(probabilities.Num());
+		return random.NextFloat() < probabilities[column] ? column : aliases[column];
+	}
+
+	int32 Num() const { return probabilities.Num(); }
+
+private:
+	TArray<float> probabilities;
+	TArray<int32> aliases;
+};
+
+/**
+ * Every loot table in a spec snapshot, built once per snapshot generation.
+ * Rolling only reads it, so once built it can be shared by workers populating containers in parallel.
+ * It holds its snapshot, so the entries it points into stay valid for as long as it is held.
+ */
+class SURVIVALGAME_API FLootTables
+{
+public:
+	explicit FLootTables(const FSpecDatabaseRef& snapshot);
+
+	// Cached for the current snapshot and rebuilt when it changes, game thread only.
+	// A rebuild never frees tables an earlier caller still holds
+	static TSharedRef<const FLootTables, ESPMode::ThreadSafe> Get();
+
+	uint32 GetGeneration() const { return generation; }
+
+	// Appends drops rolls from lootTableID, false if there is no such table
+	bool Roll(int32 lootTableID, int32 drops, FLootRandom& random, TArray<FInventoryItem>& outItems) const;
+
+	// Rolls straight into container, drops that no longer fit are skipped. Returns the number added.
+	// Containers stack by item id only, so rolled quality and grade are dropped here, use Roll to keep them
+	int32 Fill(UItemContainer* container, int32 lootTableID, int32 drops, FLootRandom& random) const;
+
+	// Draws per second from a synthetic table of tableSize entries
+	static double BenchmarkDraws(int32 tableSize = 1000, int32 draws = 10000000);
+
+private:
+	struct FTable
+	{
+		FAliasTable alias;
+		TArray<const FLootEntry*> entries;
+	};
+
+	FSpecDatabaseRef specs;
+	uint32 generation;
+	TMap<int32, FTable> tablesByID;
+};
@@ -2,60 +2,70 @@
 
 
 #include "Weapon.h"
+#include "ItemPool.h"
 #include "../SurvivalGameCharacter.h"
+#include "../DamageQueue.h"
 
-UWeapon* UWeapon::CreateWeapon(int32 itemID, FItemSpecification itemSpecification)
+UWeapon* UWeapon::CreateWeapon(int32 itemID)
 {
 	UWeapon* weapon = nullptr;
 
-	static const FString ContextString(TEXT("GENERAL"));
-
-	UDataTable* weaponTable = UDataTables::GetInstance()->GetWeaponTable();
-
-	for (FName weaponID : weaponTable->GetRowNames()) {
-		FWeaponSpecification* weaponSpec = weaponTable->FindRow<FWeaponSpecification>(weaponID, ContextString, true);
-
-		int32 weaponDint = FCString::Atoi(*weaponID.ToString());
-
-		if (weaponSpec != nullptr) {
-			if (weaponSpec->itemSpecificationID == itemID) {
-				switch (weaponSpec->weaponType) {
-				case EWeaponType::NORMAL: {
-					weapon = NewObject<UWeapon>();
-					weapon->SetItemSpecification(itemSpecification);
-					weapon->SetWeaponSpecification(weaponSpec);
-					break;
-				}
-				case EWeaponType::AMMO: {
-				}
-				case EWeaponType::HEAT: {
-					//weapon = UHeatWeapon::CreateHeatWeapon(weaponDint);
-					break;
-				}
-				}
-				break;
-			}
+	const FWeaponSpecification* weaponSpec = UDataTables::GetSpecs()->GetWeaponSpecification(FItemId(itemID));
+
+	if (weaponSpec != nullptr) {
+		switch (weaponSpec->weaponType) {
+		case EWeaponType::NORMAL: {
+			weapon = UItemPool::GetInstance()->Acquire<UWeapon>();
+			weapon->SetItemID(FItemId(itemID));
+			break;
+		}
+		case EWeaponType::AMMO: {
+		}
+		case EWeaponType::HEAT: {
+			//FWeaponSpecId weaponDint = UDataTables::GetSpecs()->GetWeaponSpecificationID(FItemId(itemID));
+			//weapon = UHeatWeapon::CreateHeatWeapon(weaponDint);
+			break;
+		}
 		}
 	}
 
 	return weapon;
 }
 
+const FWeaponSpecification* UWeapon::GetWeaponSpecification()
+{
+	return UDataTables::GetSpecs()->GetWeaponSpecification(GetItemID());
+}
+
+const FWeaponArchetype* UWeapon::GetArchetype()
+{
+	const FSpecDatabase* specs = UDataTables::GetSpecs();
+
+	if (archetype == nullptr || archetypeGeneration != specs->GetGeneration()) {
+		archetype = specs->GetWeaponArchetype(GetItemID());
+		archetypeGeneration = specs->GetGeneration();
+	}
+
+	return archetype;
+}
+
 bool UWeapon::CanAttack() {
 	return true;
 }
 
-void UWeapon::FireWeapon(ASurvivalGameCharacter* target)
+void UWeapon::FireWeapon(ASurvivalGameCharacter* target, ASurvivalGameCharacter* instigator)
 {
 	// Need to set up timers here to manage use rate
-	// Need to pass in damage type
-	target->ChangeHealth(weaponSpecification->healthChange, weaponSpecification->heals);
+	const FWeaponArchetype* weaponArchetype = GetArchetype();
+
+	if (weaponArchetype != nullptr)
+		FDamageQueue::Get().Add(target, instigator, weaponArchetype->healthChange, weaponArchetype->heals, weaponArchetype->damageType);
 }
 
-void UWeapon::AttackTarget(ASurvivalGameCharacter* target)
+void UWeapon::AttackTarget(ASurvivalGameCharacter* target, ASurvivalGameCharacter* instigator)
 {
 	if (CanAttack()) {
-		FireWeapon(target);
+		FireWeapon(target, instigator);
 	}
 }
 
@@ -14,17 +14,21 @@ class SURVIVALGAME_API UWeapon : public UTool
 	GENERATED_BODY()
 
 private:
-	FWeaponSpecification* weaponSpecification;
+	// Re-resolved through the item id whenever the spec tables are swapped
+	const FWeaponArchetype* archetype;
+	uint32 archetypeGeneration;
 
 	virtual bool CanAttack();
-	virtual void FireWeapon(ASurvivalGameCharacter* target);
+	virtual void FireWeapon(ASurvivalGameCharacter* target, ASurvivalGameCharacter* instigator);
 public:
-	static UWeapon* CreateWeapon(int32 itemID, FItemSpecification weaponSpecification);
+	static UWeapon* CreateWeapon(int32 itemID);
 
-	FWeaponSpecification* GetWeaponSpecification() { return weaponSpecification; }
+	const FWeaponSpecification* GetWeaponSpecification();
+	const FWeaponArchetype* GetArchetype();
 
-	void SetWeaponSpecification(FWeaponSpecification* val) { weaponSpecification = val; }
-	void AttackTarget(ASurvivalGameCharacter* target);
+	virtual void SetItemID(FItemId val) override { Super::SetItemID(val); archetype = nullptr; }
+	// Damage is queued and lands when FDamageQueue resolves at the end of the frame
+	void AttackTarget(ASurvivalGameCharacter* target, ASurvivalGameCharacter* instigator = nullptr);
 	
 	bool CanSwap();
 	void Stop();
@@ -0,0 +1,671 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WorldSave.h"
+#include "../SurvivalGameCharacter.h"
+#include "../Stat.h"
+#include "../Items/ItemContainer.h"
+#include "../Items/Weapon.h"
+#include "../Items/Armour/Armour.h"
+#include "Async/Async.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+UWorldSave* UWorldSave::INSTANCE;
+
+namespace
+{
+	struct FSaveFileHeader
+	{
+		uint32 magic;
+		uint32 version;
+		int32 uncompressedSize;
+	};
+
+	template<typename T>
+	void SerializeRecords(FArchive& archive, TArray<T>& records)
+	{
+		int32 num = records.Num();
+		archive << num;
+
+		if (archive.IsLoading()) {
+			// Anything past the remaining bytes can only be a corrupt count
+			if (num < 0 || (int64)num * sizeof(T) > archive.TotalSize() - archive.Tell()) {
+				archive.SetError();
+				return;
+			}
+
+			records.SetNumUninitialized(num);
+		}
+
+		archive.Serialize(records.GetData(), num * sizeof(T));
+	}
+}
+
+void FSaveChunk::Serialize(FArchive& archive)
+{
+	SerializeRecords(archive, containers);
+	SerializeRecords(archive, itemCounts);
+	SerializeRecords(archive, characters);
+	SerializeRecords(archive, stats);
+	SerializeRecords(archive, equipped);
+	archive << names;
+}
+
+bool FSaveChunk::Write(TArray<uint8>& outFile)
+{
+	TArray<uint8> raw;
+	FMemoryWriter writer(raw);
+	Serialize(writer);
+
+	int32 compressedSize = FCompression::CompressMemoryBound(NAME_Zlib, raw.Num());
+	outFile.SetNumUninitialized(sizeof(FSaveFileHeader) + compressedSize);
+
+	if (!FCompression::CompressMemory(NAME_Zlib, outFile.GetData() + sizeof(FSaveFileHeader), compressedSize, raw.GetData(), raw.Num()))
+		return false;
+
+	FSaveFileHeader header = { UWorldSave::Magic, UWorldSave::Version, raw.Num() };
+	FMemory::Memcpy(outFile.GetData(), &header, sizeof(header));
+	outFile.SetNum(sizeof(FSaveFileHeader) + compressedSize, false);
+	return true;
+}
+
+bool FSaveChunk::Read(const TArray<uint8>& file)
+{
+	if (file.Num() < sizeof(FSaveFileHeader))
+		return false;
+
+	FSaveFileHeader header;
+	FMemory::Memcpy(&header, file.GetData(), sizeof(header));
+
+	if (header.magic != UWorldSave::Magic || header.version != UWorldSave::Version || header.uncompressedSize < 0)
+		return false;
+
+	TArray<uint8> raw;
+	raw.SetNumUninitialized(header.uncompressedSize);
+
+	if (!FCompression::UncompressMemory(NAME_Zlib, raw.GetData(), raw.Num(), file.GetData() + sizeof(FSaveFileHeader), file.Num() - sizeof(FSaveFileHeader)))
+		return false;
+
+	FMemoryReader reader(raw);
+	Serialize(reader);
+
+	if (reader.IsError())
+		return false;
+
+	// Every range has to land inside its pool, so restoring never reads out of bounds
+	auto inRange = [](int32 first, int32 count, int32 num) { return first >= 0 && count >= 0 && first <= num - count; };
+
+	for (const FSaveContainerRecord& record : containers) {
+		if (!inRange(record.firstItem, record.itemCount, itemCounts.Num()))
+			return false;
+	}
+
+	for (const FSaveCharacterRecord& record : characters) {
+		if (!inRange(record.firstStat, record.statCount, stats.Num()) || !inRange(record.firstEquipped, record.equippedCount, equipped.Num()))
+			return false;
+	}
+
+	for (const FSaveStatRecord& stat : stats) {
+		if (!names.IsValidIndex(stat.nameIndex))
+			return false;
+	}
+
+	// Enums are cast straight from these bytes, anything past the last value can only be corrupt
+	for (const FSaveEquippedRecord& record : equipped) {
+		if ((uint8)record.slot > (uint8)ESaveEquippedSlot::ARMOUR || record.position > (uint8)EPosition::BOTH_HANDS)
+			return false;
+	}
+
+	return true;
+}
+
+void UWorldSave::BeginDestroy()
+{
+	if (this == INSTANCE) {
+		Flush();
+		INSTANCE = nullptr;
+	}
+
+	Super::BeginDestroy();
+}
+
+void UWorldSave::Tick(float DeltaTime)
+{
+	UpdateCharacterCells();
+
+	timeSinceAutosave += DeltaTime;
+
+	if (timeSinceAutosave >= autosaveInterval) {
+		timeSinceAutosave = 0;
+		Autosave();
+	}
+}
+
+UWorldSave* UWorldSave::GetInstance()
+{
+	if (INSTANCE == nullptr)
+	{
+		check(IsInGameThread());
+
+		INSTANCE = NewObject<UWorldSave>();
+		INSTANCE->AddToRoot();
+	}
+
+	return INSTANCE;
+}
+
+uint64 UWorldSave::MakeKey(const UObject* object)
+{
+	FTCHARToUTF8 path(*object->GetPathName());
+	return CityHash64(path.Get(), path.Length());
+}
+
+FIntPoint UWorldSave::GetCell(const FVector& location) const
+{
+	return FIntPoint(FMath::FloorToInt(location.X / cellSize), FMath::FloorToInt(location.Y / cellSize));
+}
+
+FString UWorldSave::GetCellPath(const FIntPoint& cell) const
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("WorldSave"), slotName, FString::Printf(TEXT("%d_%d.sgc"), cell.X, cell.Y));
+}
+
+void UWorldSave::RegisterContainer(UItemContainer* container, uint64 key, const FVector& location)
+{
+	check(IsInGameThread());
+
+	FContainerEntry& entry = containers.FindOrAdd(key);
+	entry.container = container;
+	entry.cell = GetCell(location);
+	entry.savedVersion = container->GetVersion();
+	cells.FindOrAdd(entry.cell).containerKeys.AddUnique(key);
+
+	FPendingRecord pending;
+
+	if (pendingContainers.RemoveAndCopyValue(key, pending)) {
+		RestoreContainer(container, *pending.chunk, pending.chunk->containers[pending.index]);
+		entry.savedVersion = container->GetVersion();
+	}
+}
+
+void UWorldSave::RegisterCharacter(ASurvivalGameCharacter* character, uint64 key)
+{
+	check(IsInGameThread());
+
+	FCharacterEntry& entry = characters.FindOrAdd(key);
+	entry.character = character;
+	entry.cell = GetCell(character->GetActorLocation());
+	entry.dirty = false;
+	entry.current = false;
+	cells.FindOrAdd(entry.cell).characterKeys.AddUnique(key);
+
+	FPendingRecord pending;
+
+	if (pendingCharacters.RemoveAndCopyValue(key, pending)) {
+		RestoreCharacter(character, *pending.chunk, pending.chunk->characters[pending.index]);
+
+		FCharacterEntry& restored = characters.FindChecked(key);
+		restored.current = true;
+		restored.dirty = false;
+		GetStatValues(character, restored.savedValues);
+	}
+
+	LoadAround(character->GetActorLocation(), loadRadius);
+}
+
+void UWorldSave::RegisterContainerForActor(UItemContainer* container, AActor* owner)
+{
+	if (container != nullptr && owner != nullptr)
+		RegisterContainer(container, MakeKey(container), owner->GetActorLocation());
+}
+
+void UWorldSave::UpdateCharacterCells()
+{
+	TArray<FVector> moved;
+
+	for (TPair<uint64, FCharacterEntry>& entry : characters) {
+		ASurvivalGameCharacter* character = entry.Value.character.Get();
+
+		if (character == nullptr)
+			continue;
+
+		FVector location = character->GetActorLocation();
+		FIntPoint cell = GetCell(location);
+
+		if (cell == entry.Value.cell)
+			continue;
+
+		// The old cell is rewritten without the record and the new one with it
+		FCell& oldCell = cells.FindOrAdd(entry.Value.cell);
+		oldCell.characterKeys.Remove(entry.Key);
+		oldCell.forceDirty = true;
+		RequestCell(entry.Value.cell);
+
+		cells.FindOrAdd(cell).characterKeys.AddUnique(entry.Key);
+		entry.Value.cell = cell;
+		entry.Value.dirty = true;
+		moved.Add(location);
+	}
+
+	for (const FVector& location : moved) {
+		LoadAround(location, loadRadius);
+	}
+}
+
+void UWorldSave::MarkCharacterDirty(uint64 key)
+{
+	FCharacterEntry* entry = characters.Find(key);
+
+	if (entry != nullptr)
+		entry->dirty = true;
+}
+
+void UWorldSave::LoadAround(const FVector& location, float radius)
+{
+	check(IsInGameThread());
+
+	FIntPoint minCell = GetCell(location - FVector(radius, radius, 0));
+	FIntPoint maxCell = GetCell(location + FVector(radius, radius, 0));
+
+	for (int32 x = minCell.X; x <= maxCell.X; x++) {
+		for (int32 y = minCell.Y; y <= maxCell.Y; y++) {
+			RequestCell(FIntPoint(x, y));
+		}
+	}
+}
+
+void UWorldSave::RequestCell(const FIntPoint& cellPosition)
+{
+	FCell& cell = cells.FindOrAdd(cellPosition);
+
+	if (cell.state != EChunkState::UNLOADED)
+		return;
+
+	cell.state = EChunkState::LOADING;
+
+	Async<void>(EAsyncExecution::ThreadPool, [this, cellPosition, path = GetCellPath(cellPosition)]() {
+		auto readChunk = [](const FString& filePath) {
+			FSaveChunkPtr chunk = MakeShared<FSaveChunk, ESPMode::ThreadSafe>();
+			TArray<uint8> file;
+
+			if (!FFileHelper::LoadFileToArray(file, *filePath, FILEREAD_Silent) || !chunk->Read(file))
+				chunk.Reset();
+
+			return chunk;
+		};
+
+		// The cell is only missing if a write stopped between moving it aside and moving the new one in,
+		// the backup is the last whole save then. With neither readable the cell starts empty
+		FSaveChunkPtr chunk = readChunk(path);
+
+		if (!chunk.IsValid())
+			chunk = readChunk(path + TEXT(".bak"));
+
+		AsyncTask(ENamedThreads::GameThread, [this, cellPosition, chunk]() {
+			OnCellLoaded(cellPosition, chunk);
+		});
+	});
+}
+
+void UWorldSave::OnCellLoaded(FIntPoint cellPosition, FSaveChunkPtr chunk)
+{
+	UDataTables* dataTables = UDataTables::GetInstance();
+
+	// Restoring resolves item ids, so hold the cell back until the tables are indexed
+	if (!dataTables->IsReady()) {
+		dataTables->WhenReady(FSimpleDelegate::CreateUObject(this, &UWorldSave::OnCellLoaded, cellPosition, chunk));
+		return;
+	}
+
+	FCell& cell = cells.FindOrAdd(cellPosition);
+	cell.state = EChunkState::LOADED;
+	cell.loaded = chunk;
+
+	if (!chunk.IsValid())
+		return;
+
+	for (int32 i = 0; i < chunk->containers.Num(); i++) {
+		const FSaveContainerRecord& record = chunk->containers[i];
+		FContainerEntry* entry = containers.Find(record.key);
+
+		if (entry != nullptr && entry->container.IsValid()) {
+			RestoreContainer(entry->container.Get(), *chunk, record);
+			entry->savedVersion = entry->container->GetVersion();
+		}
+		else {
+			pendingContainers.Add(record.key, { chunk, i });
+		}
+	}
+
+	for (int32 i = 0; i < chunk->characters.Num(); i++) {
+		const FSaveCharacterRecord& record = chunk->characters[i];
+		FCharacterEntry* entry = characters.Find(record.key);
+
+		if (entry == nullptr || !entry->character.IsValid()) {
+			pendingCharacters.Add(record.key, { chunk, i });
+			continue;
+		}
+
+		// A character that has already been restored or saved walked in here after this record was written
+		if (entry->current) {
+			cell.forceDirty = true;
+			continue;
+		}
+
+		RestoreCharacter(entry->character.Get(), *chunk, record);
+
+		entry = characters.Find(record.key);
+		entry->current = true;
+		entry->dirty = false;
+		GetStatValues(entry->character.Get(), entry->savedValues);
+	}
+}
+
+bool UWorldSave::IsCellDirty(const FCell& cell) const
+{
+	if (cell.forceDirty)
+		return true;
+
+	for (uint64 key : cell.containerKeys) {
+		const FContainerEntry& entry = containers.FindChecked(key);
+
+		if (entry.container.IsValid() && entry.container->GetVersion() != entry.savedVersion)
+			return true;
+	}
+
+	for (uint64 key : cell.characterKeys) {
+		const FCharacterEntry& entry = characters.FindChecked(key);
+
+		if (entry.dirty || HaveStatsChanged(entry))
+			return true;
+	}
+
+	return false;
+}
+
+void UWorldSave::GetStatValues(ASurvivalGameCharacter* character, TArray<float>& outValues)
+{
+	outValues.Reset();
+
+	for (UStat* stat : character->GetStats()) {
+		outValues.Add(stat->GetCurrentValue());
+	}
+}
+
+bool UWorldSave::HaveStatsChanged(const FCharacterEntry& entry)
+{
+	ASurvivalGameCharacter* character = entry.character.Get();
+
+	if (character == nullptr)
+		return false;
+
+	const TArray<UStat*>& stats = character->GetStats();
+
+	if (stats.Num() != entry.savedValues.Num())
+		return true;
+
+	for (int32 i = 0; i < stats.Num(); i++) {
+		if (stats[i]->GetCurrentValue() != entry.savedValues[i])
+			return true;
+	}
+
+	return false;
+}
+
+FSaveChunkPtr UWorldSave::CaptureCell(FCell& cell)
+{
+	FSaveChunkPtr chunk = MakeShared<FSaveChunk, ESPMode::ThreadSafe>();
+	TArray<TPair<int32, int32>> itemCounts;
+	TMap<FString, int32> nameIndexes;
+
+	for (uint64 key : cell.containerKeys) {
+		FContainerEntry& entry = containers.FindChecked(key);
+		UItemContainer* container = entry.container.Get();
+
+		if (container == nullptr)
+			continue;
+
+		itemCounts.Reset();
+		container->GetItemCounts(itemCounts);
+
+		chunk->containers.Add({ key, container->GetVersion(), chunk->itemCounts.Num(), itemCounts.Num() });
+
+		for (const TPair<int32, int32>& itemCount : itemCounts) {
+			chunk->itemCounts.Add({ itemCount.Key, itemCount.Value });
+		}
+
+		entry.savedVersion = container->GetVersion();
+	}
+
+	for (uint64 key : cell.characterKeys) {
+		FCharacterEntry& entry = characters.FindChecked(key);
+		ASurvivalGameCharacter* character = entry.character.Get();
+
+		if (character == nullptr)
+			continue;
+
+		FSaveCharacterRecord& record = chunk->characters.AddDefaulted_GetRef();
+		record.key = key;
+		record.firstStat = chunk->stats.Num();
+		record.firstEquipped = chunk->equipped.Num();
+
+		for (UStat* stat : character->GetStats()) {
+			FString name = stat->GetStatName().ToString();
+			int32* nameIndex = nameIndexes.Find(name);
+
+			if (nameIndex == nullptr)
+				nameIndex = &nameIndexes.Add(name, chunk->names.Add(name));
+
+			// Modifiers come from equipment and effects that are restored separately, so only base limits are saved
+			chunk->stats.Add({ *nameIndex, stat->GetCurrentValue(), stat->GetBaseValue(EStatModifierTarget::MAX), stat->GetBaseValue(EStatModifierTarget::MIN) });
+		}
+
+		auto addEquipped = [&chunk](ESaveEquippedSlot slot, EPosition position, UItem* item) {
+			if (item != nullptr)
+				chunk->equipped.Add({ slot, (uint8)position, item->GetQuality(), item->GetGrade(), item->GetItemID().value, item->GetQuantity(), item->GetDurability() });
+		};
+
+		for (const TPair<EPosition, UWeapon*>& weapon : character->GetWeapons()) {
+			addEquipped(ESaveEquippedSlot::WEAPON, weapon.Key, weapon.Value);
+		}
+
+		for (const TPair<EPosition, UArmour*>& armour : character->GetArmour()) {
+			addEquipped(ESaveEquippedSlot::ARMOUR, armour.Key, armour.Value);
+		}
+
+		record.statCount = chunk->stats.Num() - record.firstStat;
+		record.equippedCount = chunk->equipped.Num() - record.firstEquipped;
+		entry.dirty = false;
+		entry.current = true;
+		GetStatValues(character, entry.savedValues);
+	}
+
+	// Objects that haven't registered since the cell was read keep their saved state
+	if (cell.loaded.IsValid()) {
+		const FSaveChunk& loaded = *cell.loaded;
+
+		for (const FSaveContainerRecord& record : loaded.containers) {
+			if (!pendingContainers.Contains(record.key))
+				continue;
+
+			chunk->containers.Add({ record.key, record.version, chunk->itemCounts.Num(), record.itemCount });
+			chunk->itemCounts.Append(loaded.itemCounts.GetData() + record.firstItem, record.itemCount);
+		}
+
+		for (const FSaveCharacterRecord& record : loaded.characters) {
+			if (!pendingCharacters.Contains(record.key))
+				continue;
+
+			chunk->characters.Add({ record.key, chunk->stats.Num(), record.statCount, chunk->equipped.Num(), record.equippedCount });
+
+			for (int32 i = record.firstStat; i < record.firstStat + record.statCount; i++) {
+				FSaveStatRecord stat = loaded.stats[i];
+				const FString& name = loaded.names[stat.nameIndex];
+				int32* nameIndex = nameIndexes.Find(name);
+
+				if (nameIndex == nullptr)
+					nameIndex = &nameIndexes.Add(name, chunk->names.Add(name));
+
+				stat.nameIndex = *nameIndex;
+				chunk->stats.Add(stat);
+			}
+
+			chunk->equipped.Append(loaded.equipped.GetData() + record.firstEquipped, record.equippedCount);
+		}
+	}
+
+	cell.forceDirty = false;
+	return chunk;
+}
+
+void UWorldSave::Autosave(float budgetSeconds)
+{
+	check(IsInGameThread());
+
+	// One batch of writes in flight at a time, dirty cells simply wait for the next call
+	if (writeTask.IsValid() && !writeTask.IsReady())
+		return;
+
+	double deadline = FPlatformTime::Seconds() + budgetSeconds;
+	TArray<TPair<FIntPoint, FSaveChunkPtr>> captured;
+
+	for (TPair<FIntPoint, FCell>& cell : cells) {
+		if (cell.Value.state != EChunkState::LOADED || !IsCellDirty(cell.Value))
+			continue;
+
+		captured.Add(TPair<FIntPoint, FSaveChunkPtr>(cell.Key, CaptureCell(cell.Value)));
+
+		if (FPlatformTime::Seconds() > deadline)
+			break;
+	}
+
+	if (captured.Num() == 0)
+		return;
+
+	TArray<FString> paths;
+
+	for (const TPair<FIntPoint, FSaveChunkPtr>& chunk : captured) {
+		paths.Add(GetCellPath(chunk.Key));
+	}
+
+	writeTask = Async<void>(EAsyncExecution::ThreadPool, [this, captured, paths]() {
+		IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+		TArray<FIntPoint> failed;
+
+		for (int32 i = 0; i < captured.Num(); i++) {
+			TArray<uint8> file;
+			FString tempPath = paths[i] + TEXT(".tmp");
+			FString backupPath = paths[i] + TEXT(".bak");
+
+			// Written aside, then the old cell becomes the backup before the new one is moved in,
+			// so wherever a crash lands either the cell or its backup is whole
+			bool written = captured[i].Value->Write(file)
+				&& FFileHelper::SaveArrayToFile(file, *tempPath)
+				&& (!platformFile.FileExists(*paths[i])
+					|| ((!platformFile.FileExists(*backupPath) || platformFile.DeleteFile(*backupPath)) && platformFile.MoveFile(*backupPath, *paths[i])))
+				&& platformFile.MoveFile(*paths[i], *tempPath);
+
+			if (!written)
+				failed.Add(captured[i].Key);
+		}
+
+		if (failed.Num() > 0) {
+			AsyncTask(ENamedThreads::GameThread, [this, failed]() {
+				for (const FIntPoint& cellPosition : failed) {
+					cells.FindOrAdd(cellPosition).forceDirty = true;
+				}
+			});
+		}
+	});
+}
+
+void UWorldSave::Flush()
+{
+	if (writeTask.IsValid())
+		writeTask.Wait();
+}
+
+void UWorldSave::RestoreContainer(UItemContainer* container, const FSaveChunk& chunk, const FSaveContainerRecord& record)
+{
+	TArray<TPair<int32, int32>> itemCounts;
+	itemCounts.Reserve(record.itemCount);
+
+	for (int32 i = record.firstItem; i < record.firstItem + record.itemCount && i < chunk.itemCounts.Num(); i++) {
+		itemCounts.Add(TPair<int32, int32>(chunk.itemCounts[i].itemID, chunk.itemCounts[i].count));
+	}
+
+	container->RestoreContents(itemCounts, record.version);
+}
+
+void UWorldSave::RestoreCharacter(ASurvivalGameCharacter* character, const FSaveChunk& chunk, const FSaveCharacterRecord& record)
+{
+	for (int32 i = record.firstStat; i < record.firstStat + record.statCount && i < chunk.stats.Num(); i++) {
+		const FSaveStatRecord& statRecord = chunk.stats[i];
+
+		if (!chunk.names.IsValidIndex(statRecord.nameIndex))
+			continue;
+
+		FText statName = FText::FromString(chunk.names[statRecord.nameIndex]);
+		UStat* stat = character->GetStatByName(statName);
+
+		if (stat == nullptr) {
+			stat = UStat::CreateStat(statName, 0, 0);
+			character->AddStat(stat);
+		}
+
+		// Limits first so the current value isn't clamped against the old ones
+		stat->SetMaxValue(statRecord.maxValue);
+		stat->SetMinValue(statRecord.minValue);
+		stat->SetCurrentValue(statRecord.currentValue);
+	}
+
+	int32 lastEquipped = FMath::Min(record.firstEquipped + record.equippedCount, chunk.equipped.Num());
+	TArray<int32> itemIDs;
+
+	for (int32 i = record.firstEquipped; i < lastEquipped; i++) {
+		itemIDs.Add(chunk.equipped[i].itemID);
+	}
+
+	TArray<UItem*> items = UItemContainer::LoadItems(itemIDs);
+	TMap<EPosition, UWeapon*> weapons;
+	TMap<EPosition, UArmour*> armour;
+
+	for (int32 i = 0; i < items.Num(); i++) {
+		const FSaveEquippedRecord& equippedRecord = chunk.equipped[record.firstEquipped + i];
+		UItem* item = items[i];
+
+		if (item == nullptr)
+			continue;
+
+		item->SetQuantity(equippedRecord.quantity);
+		item->SetQuality(equippedRecord.quality);
+		item->SetGrade(equippedRecord.grade);
+		item->SetDurability(equippedRecord.durability);
+
+		EPosition position = (EPosition)equippedRecord.position;
+
+		if (equippedRecord.slot == ESaveEquippedSlot::WEAPON && Cast<UWeapon>(item) != nullptr)
+			weapons.Add(position, Cast<UWeapon>(item));
+		else if (equippedRecord.slot == ESaveEquippedSlot::ARMOUR && Cast<UArmour>(item) != nullptr)
+			armour.Add(position, Cast<UArmour>(item));
+		else
+			UItem::ReleaseItem(item);
+	}
+
+	// Whatever the character had equipped is replaced wholesale, so the old items go back to the pool
+	for (const TPair<EPosition, UWeapon*>& weapon : character->GetWeapons()) {
+		UItem::ReleaseItem(weapon.Value);
+	}
+
+	for (const TPair<EPosition, UArmour*>& armourPiece : character->GetArmour()) {
+		UItem::ReleaseItem(armourPiece.Value);
+	}
+
+	character->SetWeapons(weapons);
+	character->SetArmour(armour);
+}
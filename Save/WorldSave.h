@@ -0,0 +1,241 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Async/Future.h"
+#include "Tickable.h"
+#include "WorldSave.generated.h"
+
+class UItemContainer;
+class ASurvivalGameCharacter;
+class AActor;
+
+// Fixed layout records, written and read as raw arrays
+
+struct FSaveContainerRecord
+{
+	uint64 key;
+	int32 version;
+	int32 firstItem;
+	int32 itemCount;
+
+	// The tail padding made explicit, so brace initialisation zeroes it rather than writing stack garbage to disk
+	int32 padding;
+};
+
+static_assert(sizeof(FSaveContainerRecord) == 24, "FSaveContainerRecord should have no implicit padding");
+
+struct FSaveItemCountRecord
+{
+	int32 itemID;
+	int32 count;
+};
+
+struct FSaveCharacterRecord
+{
+	uint64 key;
+	int32 firstStat;
+	int32 statCount;
+	int32 firstEquipped;
+	int32 equippedCount;
+};
+
+struct FSaveStatRecord
+{
+	// Into the chunk's name table
+	int32 nameIndex;
+	float currentValue;
+	float maxValue;
+	float minValue;
+};
+
+enum class ESaveEquippedSlot : uint8
+{
+	WEAPON,
+	ARMOUR
+};
+
+struct FSaveEquippedRecord
+{
+	ESaveEquippedSlot slot;
+	uint8 position;
+	uint8 quality;
+	uint8 grade;
+	int32 itemID;
+	int32 quantity;
+	float durability;
+};
+
+// Everything saved for one world cell
+struct FSaveChunk
+{
+	TArray<FSaveContainerRecord> containers;
+	TArray<FSaveItemCountRecord> itemCounts;
+	TArray<FSaveCharacterRecord> characters;
+	TArray<FSaveStatRecord> stats;
+	TArray<FSaveEquippedRecord> equipped;
+	TArray<FString> names;
+
+	void Serialize(FArchive& archive);
+
+	// Compressed file image and back, both safe off the game thread
+	bool Write(TArray<uint8>& outFile);
+	bool Read(const TArray<uint8>& file);
+};
+
+// Chunks are handed between the game thread and the thread pool
+using FSaveChunkPtr = TSharedPtr<FSaveChunk, ESPMode::ThreadSafe>;
+
+/**
+ * Chunked world save. Registered containers and characters are bucketed into square world cells,
+ * and each cell is one compressed file.
+ * Autosave only captures cells whose contents changed, within a per-call time budget, and hands
+ * serialising, compression and file writes to the thread pool. Cells are read lazily as players approach them.
+ * A cell is never written before it has been read, so unloaded saves are not overwritten.
+ * Each write keeps the previous file as a backup until the new one is in place, and reading falls back to it.
+ * Ticks itself: characters are moved between cells as they walk, and dirty cells are autosaved on an interval.
+ */
+UCLASS()
+class SURVIVALGAME_API UWorldSave : public UObject, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static const uint32 Magic = 0x43534753; // "SGSC"
+	static const uint32 Version = 1;
+
+	virtual void BeginDestroy() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return this == INSTANCE; }
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UWorldSave, STATGROUP_Tickables); }
+
+	static UWorldSave* GetInstance();
+
+	// Stable key for an object placed in a level. Spawned actors get a different path each session,
+	// so they can't be keyed this way
+	static uint64 MakeKey(const UObject* object);
+
+	void RegisterContainer(UItemContainer* container, uint64 key, const FVector& location);
+	// Also starts reading the cells around the character
+	void RegisterCharacter(ASurvivalGameCharacter* character, uint64 key);
+
+	// For containers owned by an actor, keyed by the container and filed under the actor's location
+	UFUNCTION(BlueprintCallable, Category = "Save")
+		void RegisterContainerForActor(UItemContainer* container, AActor* owner);
+
+	// Character state has no version to compare, so changes are flagged explicitly
+	void MarkCharacterDirty(uint64 key);
+
+	// Starts reading every cell within radius of location that hasn't been read yet
+	void LoadAround(const FVector& location, float radius);
+
+	// Captures dirty cells until budgetSeconds is spent, the rest are picked up by the next call
+	void Autosave(float budgetSeconds = 0.002f);
+
+	// Blocks until the last autosave's writes have finished
+	void Flush();
+
+	UFUNCTION(BlueprintCallable, Category = "Save")
+		FString GetSlotName() const { return slotName; }
+
+	UFUNCTION(BlueprintCallable, Category = "Save")
+		void SetSlotName(FString val) { slotName = val; }
+
+private:
+	static UWorldSave* INSTANCE;
+
+	enum class EChunkState : uint8
+	{
+		UNLOADED,
+		LOADING,
+		LOADED
+	};
+
+	struct FContainerEntry
+	{
+		TWeakObjectPtr<UItemContainer> container;
+		FIntPoint cell;
+		int32 savedVersion;
+	};
+
+	struct FCharacterEntry
+	{
+		TWeakObjectPtr<ASurvivalGameCharacter> character;
+		FIntPoint cell;
+		bool dirty;
+
+		// Restored or saved this session, any record still found for it in another cell is older
+		bool current;
+
+		// Stat values as last restored or saved. Regeneration moves them without going through the character,
+		// so they're compared rather than flagged
+		TArray<float> savedValues;
+	};
+
+	struct FCell
+	{
+		EChunkState state = EChunkState::UNLOADED;
+		TArray<uint64> containerKeys;
+		TArray<uint64> characterKeys;
+
+		// A write failed, so save again even if nothing has changed
+		bool forceDirty = false;
+
+		// What was read from disk, records for objects that never registered are carried over from it
+		FSaveChunkPtr loaded;
+	};
+
+	UPROPERTY(EditAnywhere, Category = "Save")
+		FString slotName = TEXT("Default");
+
+	UPROPERTY(EditAnywhere, Category = "Save")
+		float cellSize = 5000;
+
+	// Cells within this distance of a registered character are read
+	UPROPERTY(EditAnywhere, Category = "Save")
+		float loadRadius = 5000;
+
+	UPROPERTY(EditAnywhere, Category = "Save")
+		float autosaveInterval = 5;
+
+	float timeSinceAutosave = 0;
+
+	TMap<uint64, FContainerEntry> containers;
+	TMap<uint64, FCharacterEntry> characters;
+	TMap<FIntPoint, FCell> cells;
+
+	// A loaded record for an object that hasn't registered yet, applied when it does
+	struct FPendingRecord
+	{
+		FSaveChunkPtr chunk;
+		int32 index;
+	};
+
+	TMap<uint64, FPendingRecord> pendingContainers;
+	TMap<uint64, FPendingRecord> pendingCharacters;
+
+	TFuture<void> writeTask;
+
+	FIntPoint GetCell(const FVector& location) const;
+	FString GetCellPath(const FIntPoint& cell) const;
+
+	// Starts reading cell if it hasn't been read yet
+	void RequestCell(const FIntPoint& cell);
+
+	// Refiles characters that walked into another cell, both cells are rewritten
+	void UpdateCharacterCells();
+
+	bool IsCellDirty(const FCell& cell) const;
+	static void GetStatValues(ASurvivalGameCharacter* character, TArray<float>& outValues);
+	static bool HaveStatsChanged(const FCharacterEntry& entry);
+	FSaveChunkPtr CaptureCell(FCell& cell);
+	void OnCellLoaded(FIntPoint cell, FSaveChunkPtr chunk);
+
+	void RestoreContainer(UItemContainer* container, const FSaveChunk& chunk, const FSaveContainerRecord& record);
+	// Releases the character's previously equipped items to UItemPool, see ASurvivalGameCharacter::GetWeapons
+	void RestoreCharacter(ASurvivalGameCharacter* character, const FSaveChunk& chunk, const FSaveCharacterRecord& record);
+};
@@ -4,30 +4,192 @@
 UStat::UStat()
 {
 	statName = FText::FromName(FName(TEXT("Unknown")));
-	currentValue = 0;
-	maxValue = 0;
-	minValue = 0;
+	statType = FStatId();
+	slot = INDEX_NONE;
+	ownsSlot = false;
+}
+
+void UStat::BeginDestroy()
+{
+	if (IsBound()) {
+		FStatStore& store = FStatStore::Get();
+
+		if (ownsSlot)
+			store.ReleaseSlot(slot);
+		else
+			store.Remove(statType, slot);
+
+		slot = INDEX_NONE;
+	}
+
+	Super::BeginDestroy();
 }
 
 UStat* UStat::CreateStat(FText newStatName, float newCurrentValue, float newMaxValue)
 {
+	FStatStore& store = FStatStore::Get();
+
 	UStat* newStat = NewObject<UStat>();
-	newStat->SetStatName(newStatName);
-	newStat->SetCurrentValue(newCurrentValue);
-	newStat->SetMaxValue(newMaxValue);
+	newStat->statName = newStatName;
+	newStat->statType = store.FindOrAddType(FName(*newStatName.ToString()));
+	newStat->slot = store.AllocateSlot();
+	newStat->ownsSlot = true;
+
+	store.Add(newStat->statType, newStat->slot, 0, 0, newMaxValue);
+	store.SetCurrent(newStat->statType, newStat->slot, newCurrentValue);
 	return newStat;
 }
 
-void UStat::SetCurrentValue(float val)
+void UStat::SetStatName(FText val)
 {
-	if (val > maxValue) {
-		currentValue = maxValue;
+	// The owner indexes its stats by type and may already have one under the new name
+	if (IsBound() && !ownsSlot) {
+		UE_LOG(LogTemp, Warning, TEXT("Can't rename stat %s to %s once it has been added to a character"), *statName.ToString(), *val.ToString());
+		return;
 	}
-	else if (val < minValue) {
-		currentValue = minValue;
+
+	statName = val;
+
+	if (!IsBound())
+		return;
+
+	FStatStore& store = FStatStore::Get();
+	FStatId newType = store.FindOrAddType(FName(*val.ToString()));
+
+	if (newType == statType)
+		return;
+
+	store.Add(newType, slot, store.GetCurrent(statType, slot), store.GetBase(statType, slot, EStatModifierTarget::MIN), store.GetBase(statType, slot, EStatModifierTarget::MAX));
+	store.SetRate(newType, slot, store.GetBase(statType, slot, EStatModifierTarget::RATE));
+	store.Remove(statType, slot);
+	statType = newType;
+
+	watchHandle.Reset();
+	UpdateWatch();
+}
+
+void UStat::BindToSlot(int32 newSlot)
+{
+	FStatStore& store = FStatStore::Get();
+
+	if (!IsBound()) {
+		statType = store.FindOrAddType(FName(*statName.ToString()));
+		slot = newSlot;
+		store.Add(statType, slot, 0, 0, 0);
+		UpdateWatch();
+		return;
 	}
-	else {
-		currentValue = val;
+
+	if (newSlot == slot)
+		return;
+	store.Add(statType, newSlot, store.GetCurrent(statType, slot), store.GetBase(statType, slot, EStatModifierTarget::MIN), store.GetBase(statType, slot, EStatModifierTarget::MAX));
+	store.SetRate(statType, newSlot, store.GetBase(statType, slot, EStatModifierTarget::RATE));
+
+	if (ownsSlot)
+		store.ReleaseSlot(slot);
+	else
+		store.Remove(statType, slot);
+
+	slot = newSlot;
+	ownsSlot = false;
+
+	// Removing the old lane dropped its watch
+	watchHandle.Reset();
+	UpdateWatch();
+}
+
+void UStat::Unbind()
+{
+	if (ownsSlot)
+		return;
+
+	// Releasing the slot drops the lane's watch and modifiers
+	slot = INDEX_NONE;
+	watchHandle.Reset();
+}
+
+float UStat::GetCurrentValue()
+{
+	return IsBound() ? FStatStore::Get().GetCurrent(statType, slot) : 0;
+}
+
+void UStat::SetCurrentValue(float val)
+{
+	if (IsBound())
+		FStatStore::Get().SetCurrent(statType, slot, val);
+}
+
+float UStat::GetMaxValue()
+{
+	return IsBound() ? FStatStore::Get().GetMax(statType, slot) : 0;
+}
+
+void UStat::SetMaxValue(float val)
+{
+	if (IsBound())
+		FStatStore::Get().SetMax(statType, slot, val);
+}
+
+float UStat::GetMinValue()
+{
+	return IsBound() ? FStatStore::Get().GetMin(statType, slot) : 0;
+}
+
+void UStat::SetMinValue(float val)
+{
+	if (IsBound())
+		FStatStore::Get().SetMin(statType, slot, val);
+}
+
+int32 UStat::AddModifier(EStatModifierTarget target, EStatModifierOp op, float value, float duration)
+{
+	if (!IsBound())
+		return INDEX_NONE;
+
+	return FStatStore::Get().AddModifier(statType, slot, target, op, value, duration).value;
+}
+
+void UStat::RemoveModifier(int32 modifierID)
+{
+	FStatStore::Get().RemoveModifier(FStatModifierId(modifierID));
+}
+
+float UStat::GetBaseValue(EStatModifierTarget target)
+{
+	return IsBound() ? FStatStore::Get().GetBase(statType, slot, target) : 0;
+}
+
+void UStat::Subscribe(FOnStatChangedDynamic listener)
+{
+	listeners.Add(listener);
+	UpdateWatch();
+}
+
+void UStat::Unsubscribe(FOnStatChangedDynamic listener)
+{
+	listeners.Remove(listener);
+
+	if (listeners.Num() == 0 && watchHandle.IsValid()) {
+		FStatStore::Get().Unwatch(statType, slot, watchHandle);
+		watchHandle.Reset();
 	}
 }
 
+void UStat::UpdateWatch()
+{
+	if (IsBound() && listeners.Num() > 0 && !watchHandle.IsValid())
+		watchHandle = FStatStore::Get().Watch(statType, slot, FOnStatChanged::FDelegate::CreateUObject(this, &UStat::OnLaneChanged));
+}
+
+void UStat::OnLaneChanged(const FStatChange& change)
+{
+	// Listeners whose objects have been destroyed are dropped
+	listeners.RemoveAll([](const FOnStatChangedDynamic& listener) { return !listener.IsBound(); });
+
+	// Copied so listeners can unsubscribe while being called
+	TArray<FOnStatChangedDynamic> called = listeners;
+
+	for (const FOnStatChangedDynamic& listener : called) {
+		listener.ExecuteIfBound(this, change);
+	}
+}
@@ -4,10 +4,14 @@
 
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
+#include "StatStore.h"
 #include "Stat.generated.h"
 
+DECLARE_DYNAMIC_DELEGATE_TwoParams(FOnStatChangedDynamic, UStat*, stat, const FStatChange&, change);
+
 /**
- *
+ * Blueprint facing handle onto one (stat type, owner slot) lane of FStatStore, the values live in the store.
+ * A stat made with CreateStat owns a slot of its own until it is added to a character, which moves it into the character's slot.
  */
 UCLASS()
 class SURVIVALGAME_API UStat : public UObject
@@ -16,37 +20,81 @@ class SURVIVALGAME_API UStat : public UObject
 
 private:
 	FText statName;
-	float currentValue;
-	float maxValue;
-	float minValue;
+	FStatId statType;
+	int32 slot;
+	bool ownsSlot;
+
+	// The lane is only watched while someone is subscribed
+	TArray<FOnStatChangedDynamic> listeners;
+	FDelegateHandle watchHandle;
 
 public:
 	UStat();
 
+	virtual void BeginDestroy() override;
+
 	UFUNCTION(BlueprintCallable, Category = "Stat")
 		static UStat* CreateStat(FText newStatName, float newCurrentValue, float newMaxValue);
 
 	UFUNCTION(BlueprintCallable, Category = "Stat")
 		FText GetStatName() { return statName; }
 
+	// Ignored once the stat has been added to a character, rename it before adding it
 	UFUNCTION(BlueprintCallable, Category = "Stat")
-		void SetStatName(FText val) { statName = val; }
+		void SetStatName(FText val);
 
 	UFUNCTION(BlueprintCallable, Category = "Stat")
-		float GetCurrentValue() { return currentValue; }
+		float GetCurrentValue();
 
 	UFUNCTION(BlueprintCallable, Category = "Stat")
 		void SetCurrentValue(float val);
 
 	UFUNCTION(BlueprintCallable, Category = "Stat")
-		float GetMaxValue() { return maxValue; }
+		float GetMaxValue();
+
+	UFUNCTION(BlueprintCallable, Category = "Stat")
+		void SetMaxValue(float val);
 
 	UFUNCTION(BlueprintCallable, Category = "Stat")
-		void SetMaxValue(float val) { maxValue = val; }
+		float GetMinValue();
 
 	UFUNCTION(BlueprintCallable, Category = "Stat")
-		float GetMinValue() { return minValue; }
+		void SetMinValue(float val);
 
+	// Returns the modifier's id for RemoveModifier, or -1 if the stat isn't bound.
+	// Modifiers are dropped if the stat is renamed or moved to another slot
 	UFUNCTION(BlueprintCallable, Category = "Stat")
-		void SetMinValue(float val) { minValue = val; }
+		int32 AddModifier(EStatModifierTarget target, EStatModifierOp op, float value, float duration);
+
+	UFUNCTION(BlueprintCallable, Category = "Stat")
+		void RemoveModifier(int32 modifierID);
+
+	// Called at the end of any frame the value changed in, once per frame
+	UFUNCTION(BlueprintCallable, Category = "Stat")
+		void Subscribe(FOnStatChangedDynamic listener);
+
+	UFUNCTION(BlueprintCallable, Category = "Stat")
+		void Unsubscribe(FOnStatChangedDynamic listener);
+
+	// The value before modifiers
+	UFUNCTION(BlueprintCallable, Category = "Stat")
+		float GetBaseValue(EStatModifierTarget target);
+
+	FStatId GetStatType() { return statType; }
+	int32 GetSlot() { return slot; }
+
+	// Moves the values to newSlot, giving up the stat's own slot if it had one.
+	// A stat that was never bound is typed by its name and starts at zero
+	void BindToSlot(int32 newSlot);
+
+	// Forgets a slot owned by someone else without touching it, called by the owner before it releases the slot.
+	// The stat reads as zero from then on
+	void Unbind();
+
+private:
+	bool IsBound() { return statType.IsValid() && slot != INDEX_NONE; }
+
+	// Watches the current lane if there are listeners, call after the lane changes
+	void UpdateWatch();
+	void OnLaneChanged(const FStatChange& change);
 };
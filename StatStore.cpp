@@ -0,0 +1,467 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StatStore.h"
+#include "Async/ParallelFor.h"
+
+const FStatId FStatStore::Health(0);
+
+FStatStore::FStatStore()
+{
+	verify(FindOrAddType(TEXT("Health")) == Health);
+}
+
+FStatStore& FStatStore::Get()
+{
+	check(IsInGameThread());
+
+	static FStatStore Store;
+	return Store;
+}
+
+FStatId FStatStore::FindOrAddType(FName typeName)
+{
+	FStatId* statType = typesByName.Find(typeName);
+
+	if (statType != nullptr)
+		return *statType;
+
+	ResizeColumn(columns.AddDefaulted_GetRef());
+	typeNames.Add(typeName);
+	return typesByName.Add(typeName, FStatId(columns.Num() - 1));
+}
+
+FStatId FStatStore::FindType(FName typeName) const
+{
+	const FStatId* statType = typesByName.Find(typeName);
+	return statType != nullptr ? *statType : FStatId();
+}
+
+int32 FStatStore::AllocateSlot()
+{
+	if (freeSlots.Num() > 0)
+		return freeSlots.Pop(false);
+
+	if (usedSlots == slotCapacity) {
+		slotCapacity = FMath::Max(Align(slotCapacity * 2, 4), 64);
+
+		for (FStatColumn& column : columns) {
+			ResizeColumn(column);
+		}
+	}
+
+	return usedSlots++;
+}
+
+void FStatStore::ReleaseSlot(int32 slot)
+{
+	if (slot == INDEX_NONE)
+		return;
+
+	for (int32 statType = 0; statType < columns.Num(); statType++) {
+		Remove(FStatId(statType), slot);
+	}
+
+	freeSlots.Add(slot);
+}
+
+void FStatStore::ResizeColumn(FStatColumn& column)
+{
+	// New lanes start zeroed, which the batch operations leave alone
+	column.current.SetNumZeroed(slotCapacity);
+	column.minimum.SetNumZeroed(slotCapacity);
+	column.maximum.SetNumZeroed(slotCapacity);
+	column.rate.SetNumZeroed(slotCapacity);
+	column.present.Add(false, slotCapacity - column.present.Num());
+	column.watched.Add(false, slotCapacity - column.watched.Num());
+}
+
+void FStatStore::Add(FStatId statType, int32 slot, float currentValue, float minValue, float maxValue)
+{
+	RemoveModifiers(statType, slot);
+
+	FStatColumn& column = columns[statType.value];
+	column.present[slot] = true;
+	column.minimum[slot] = minValue;
+	column.maximum[slot] = maxValue;
+	column.rate[slot] = 0;
+	SetCurrent(statType, slot, currentValue);
+}
+
+void FStatStore::Remove(FStatId statType, int32 slot)
+{
+	RemoveModifiers(statType, slot);
+
+	if (watches.Num() > 0)
+		watches.Remove(MakeLaneKey(statType, slot));
+
+	FStatColumn& column = columns[statType.value];
+	column.present[slot] = false;
+	column.watched[slot] = false;
+	column.current[slot] = 0;
+	column.minimum[slot] = 0;
+	column.maximum[slot] = 0;
+	column.rate[slot] = 0;
+}
+
+void FStatStore::SetCurrent(FStatId statType, int32 slot, float val)
+{
+	FStatColumn& column = columns[statType.value];
+
+	// Min applied before max, so a max below min wins, the same as ClampValue and FDamageQueue
+	column.current[slot] = FMath::Min(FMath::Max(val, column.minimum[slot]), column.maximum[slot]);
+
+	if (column.watched[slot])
+		MarkDirty(MakeLaneKey(statType, slot));
+}
+
+void FStatStore::MarkDirty(uint64 laneKey)
+{
+	FStatWatch* watch = watches.Find(laneKey);
+
+	if (watch != nullptr && !watch->dirty) {
+		watch->dirty = true;
+		dirtyLanes.Add(laneKey);
+	}
+}
+
+FDelegateHandle FStatStore::Watch(FStatId statType, int32 slot, const FOnStatChanged::FDelegate& listener)
+{
+	check(Has(statType, slot));
+
+	uint64 laneKey = MakeLaneKey(statType, slot);
+	FStatWatch* watch = watches.Find(laneKey);
+
+	if (watch == nullptr) {
+		watch = &watches.Add(laneKey);
+		watch->statType = statType;
+		watch->slot = slot;
+		watch->lastValue = GetCurrent(statType, slot);
+		watch->dirty = false;
+		columns[statType.value].watched[slot] = true;
+	}
+
+	return watch->listeners.Add(listener);
+}
+
+void FStatStore::Unwatch(FStatId statType, int32 slot, FDelegateHandle handle)
+{
+	uint64 laneKey = MakeLaneKey(statType, slot);
+	FStatWatch* watch = watches.Find(laneKey);
+
+	if (watch == nullptr)
+		return;
+
+	watch->listeners.Remove(handle);
+
+	// Any entry left in dirtyLanes is skipped on delivery
+	if (!watch->listeners.IsBound()) {
+		watches.Remove(laneKey);
+		columns[statType.value].watched[slot] = false;
+	}
+}
+
+void FStatStore::DeliverChanges()
+{
+	if (dirtyLanes.Num() == 0)
+		return;
+
+	// Changes made by listeners are delivered next frame
+	TArray<uint64> lanes = MoveTemp(dirtyLanes);
+	dirtyLanes.Reset();
+
+	TArray<TPair<uint64, FStatChange>> changes;
+
+	for (uint64 laneKey : lanes) {
+		FStatWatch* watch = watches.Find(laneKey);
+
+		if (watch == nullptr || !watch->dirty)
+			continue;
+
+		watch->dirty = false;
+		float newValue = GetCurrent(watch->statType, watch->slot);
+
+		if (newValue == watch->lastValue)
+			continue;
+
+		FStatChange& change = changes.AddDefaulted_GetRef().Value;
+		changes.Last().Key = laneKey;
+		change.oldValue = watch->lastValue;
+		change.newValue = newValue;
+		change.maxValue = GetMax(watch->statType, watch->slot);
+		change.depleted = change.oldValue > 0 && newValue <= 0;
+		change.restored = change.oldValue <= 0 && newValue > 0;
+
+		float low = change.maxValue * LowFraction;
+		change.becameLow = change.oldValue >= low && newValue < low;
+		change.recovered = change.oldValue < low && newValue >= low;
+
+		watch->lastValue = newValue;
+	}
+
+	for (const TPair<uint64, FStatChange>& change : changes) {
+		FStatWatch* watch = watches.Find(change.Key);
+
+		if (watch == nullptr)
+			continue;
+
+		// Copied because a listener can add or remove watches, which may move this one
+		FOnStatChanged listeners = watch->listeners;
+		listeners.Broadcast(change.Value);
+	}
+}
+
+float& FStatStore::GetEffective(FStatId statType, int32 slot, EStatModifierTarget target)
+{
+	FStatColumn& column = columns[statType.value];
+
+	switch (target) {
+	case EStatModifierTarget::MIN:
+		return column.minimum[slot];
+	case EStatModifierTarget::RATE:
+		return column.rate[slot];
+	default:
+		return column.maximum[slot];
+	}
+}
+
+float FStatStore::GetBase(FStatId statType, int32 slot, EStatModifierTarget target) const
+{
+	const FStatModifierStack* stack = modifierStacks.Find(MakeLaneKey(statType, slot));
+
+	if (stack != nullptr)
+		return stack->baseValues[(uint8)target];
+
+	switch (target) {
+	case EStatModifierTarget::MIN:
+		return GetMin(statType, slot);
+	case EStatModifierTarget::RATE:
+		return GetRate(statType, slot);
+	default:
+		return GetMax(statType, slot);
+	}
+}
+
+void FStatStore::SetBase(FStatId statType, int32 slot, EStatModifierTarget target, float val)
+{
+	FStatModifierStack* stack = modifierStacks.Find(MakeLaneKey(statType, slot));
+
+	// No modifiers means base and effective are the same value
+	if (stack == nullptr) {
+		GetEffective(statType, slot, target) = val;
+
+		// The limits may have moved under the current value, as in Recompute
+		SetCurrent(statType, slot, GetCurrent(statType, slot));
+		return;
+	}
+
+	stack->baseValues[(uint8)target] = val;
+	Recompute(statType, slot, *stack);
+}
+
+void FStatStore::Recompute(FStatId statType, int32 slot, const FStatModifierStack& stack)
+{
+	float flat[3] = { 0, 0, 0 };
+	float percent[3] = { 0, 0, 0 };
+	const FStatModifier* overrides[3] = { nullptr, nullptr, nullptr };
+
+	for (const FStatModifier& modifier : stack.modifiers) {
+		uint8 target = (uint8)modifier.target;
+
+		switch (modifier.op) {
+		case EStatModifierOp::FLAT:
+			flat[target] += modifier.value;
+			break;
+		case EStatModifierOp::PERCENT:
+			percent[target] += modifier.value;
+			break;
+		case EStatModifierOp::OVERRIDE:
+			// Modifiers are in the order they were added
+			overrides[target] = &modifier;
+			break;
+		}
+	}
+
+	for (uint8 target = 0; target < 3; target++) {
+		float value = overrides[target] != nullptr ? overrides[target]->value : (stack.baseValues[target] + flat[target]) * (1 + percent[target]);
+		GetEffective(statType, slot, (EStatModifierTarget)target) = value;
+	}
+
+	// The limits may have moved under the current value
+	SetCurrent(statType, slot, GetCurrent(statType, slot));
+}
+
+FStatModifierId FStatStore::AddModifier(FStatId statType, int32 slot, EStatModifierTarget target, EStatModifierOp op, float value, float duration)
+{
+	if (!Has(statType, slot))
+		return FStatModifierId();
+
+	uint64 laneKey = MakeLaneKey(statType, slot);
+	FStatModifierStack* stack = modifierStacks.Find(laneKey);
+
+	if (stack == nullptr) {
+		stack = &modifierStacks.Add(laneKey);
+		stack->baseValues[(uint8)EStatModifierTarget::MAX] = GetMax(statType, slot);
+		stack->baseValues[(uint8)EStatModifierTarget::MIN] = GetMin(statType, slot);
+		stack->baseValues[(uint8)EStatModifierTarget::RATE] = GetRate(statType, slot);
+	}
+
+	FStatModifierId modifierID(nextModifierID++);
+	stack->modifiers.Add({ modifierID, target, op, value });
+	modifierLanes.Add(modifierID, { statType, slot });
+
+	if (duration > 0)
+		expiries.HeapPush(FStatExpiry(clock + duration, modifierID), ExpiresEarlier);
+
+	Recompute(statType, slot, *stack);
+	return modifierID;
+}
+
+void FStatStore::RemoveModifier(FStatModifierId modifierID)
+{
+	FStatLane lane;
+
+	if (!modifierLanes.RemoveAndCopyValue(modifierID, lane))
+		return;
+
+	uint64 laneKey = MakeLaneKey(lane.statType, lane.slot);
+	FStatModifierStack& stack = modifierStacks.FindChecked(laneKey);
+	stack.modifiers.RemoveAll([modifierID](const FStatModifier& modifier) { return modifier.id == modifierID; });
+
+	if (stack.modifiers.Num() > 0) {
+		Recompute(lane.statType, lane.slot, stack);
+		return;
+	}
+
+	// Back to plain base values, the lane no longer needs a stack
+	for (uint8 target = 0; target < 3; target++) {
+		GetEffective(lane.statType, lane.slot, (EStatModifierTarget)target) = stack.baseValues[target];
+	}
+
+	modifierStacks.Remove(laneKey);
+	SetCurrent(lane.statType, lane.slot, GetCurrent(lane.statType, lane.slot));
+}
+
+void FStatStore::RemoveModifiers(FStatId statType, int32 slot)
+{
+	FStatModifierStack stack;
+
+	if (!modifierStacks.RemoveAndCopyValue(MakeLaneKey(statType, slot), stack))
+		return;
+
+	// Their heap entries are dropped as they come due
+	for (const FStatModifier& modifier : stack.modifiers) {
+		modifierLanes.Remove(modifier.id);
+	}
+}
+
+void FStatStore::ExpireModifiers(float deltaTime)
+{
+	clock += deltaTime;
+
+	while (expiries.Num() > 0 && expiries.HeapTop().Key <= clock) {
+		FStatExpiry expiry;
+		expiries.HeapPop(expiry, ExpiresEarlier, false);
+
+		// A no-op if the modifier was already removed
+		RemoveModifier(expiry.Value);
+	}
+}
+
+VectorRegister FStatStore::ClampValue(const VectorRegister& value, const float* minimum, const float* maximum)
+{
+	// Min applied before max, so a max below min wins, the same as SetCurrent
+	return VectorMin(VectorMax(value, VectorLoadAligned(minimum)), VectorLoadAligned(maximum));
+}
+
+void FStatStore::AddChangedLanes(int32 statType, int32 first, const VectorRegister& before, const VectorRegister& after, TArray<uint64>& changedLanes) const
+{
+	int32 changed = VectorMaskBits(VectorCompareNE(before, after));
+
+	if (changed == 0)
+		return;
+
+	const TBitArray<>& watched = columns[statType].watched;
+
+	for (int32 lane = 0; lane < 4; lane++) {
+		if ((changed & (1 << lane)) != 0 && watched[first + lane])
+			changedLanes.Add(MakeLaneKey(FStatId(statType), first + lane));
+	}
+}
+
+void FStatStore::ClampLanes(FStatId statType, int32 first, int32 num, TArray<uint64>& changedLanes)
+{
+	FStatColumn& column = columns[statType.value];
+	bool anyWatched = watches.Num() > 0;
+
+	for (int32 i = first; i < first + num; i += 4) {
+		VectorRegister before = VectorLoadAligned(column.current.GetData() + i);
+		VectorRegister value = ClampValue(before, column.minimum.GetData() + i, column.maximum.GetData() + i);
+		VectorStoreAligned(value, column.current.GetData() + i);
+
+		if (anyWatched)
+			AddChangedLanes(statType.value, i, before, value, changedLanes);
+	}
+}
+
+void FStatStore::Clamp(FStatId statType)
+{
+	TArray<uint64> changedLanes;
+	ClampLanes(statType, 0, usedSlots > 0 ? Align(usedSlots, 4) : 0, changedLanes);
+
+	for (uint64 laneKey : changedLanes) {
+		MarkDirty(laneKey);
+	}
+}
+
+void FStatStore::ClampAll()
+{
+	for (int32 statType = 0; statType < columns.Num(); statType++) {
+		Clamp(FStatId(statType));
+	}
+}
+
+void FStatStore::Regenerate(float deltaTime, bool parallel)
+{
+	int32 num = usedSlots > 0 ? Align(usedSlots, 4) : 0;
+	int32 numTasks = FMath::DivideAndRoundUp(num, LanesPerTask);
+
+	// One list per task, so tasks report their changes without sharing an array
+	TArray<TArray<uint64>> changedLanes;
+	changedLanes.SetNum(numTasks);
+
+	// Tasks write disjoint lane ranges, so they need no locking
+	ParallelFor(numTasks, [this, num, deltaTime, &changedLanes](int32 task) {
+		int32 first = task * LanesPerTask;
+		RegenerateLanes(first, FMath::Min(LanesPerTask, num - first), deltaTime, changedLanes[task]);
+	}, !parallel || numTasks < 2);
+
+	for (const TArray<uint64>& taskLanes : changedLanes) {
+		for (uint64 laneKey : taskLanes) {
+			MarkDirty(laneKey);
+		}
+	}
+}
+
+void FStatStore::RegenerateLanes(int32 first, int32 num, float deltaTime, TArray<uint64>& changedLanes)
+{
+	VectorRegister delta = VectorSetFloat1(deltaTime);
+	bool anyWatched = watches.Num() > 0;
+
+	for (int32 statType = 0; statType < columns.Num(); statType++) {
+		FStatColumn& column = columns[statType];
+		float* current = column.current.GetData();
+		const float* rate = column.rate.GetData();
+
+		for (int32 i = first; i < first + num; i += 4) {
+			VectorRegister before = VectorLoadAligned(current + i);
+			VectorRegister value = VectorMultiplyAdd(VectorLoadAligned(rate + i), delta, before);
+			value = ClampValue(value, column.minimum.GetData() + i, column.maximum.GetData() + i);
+			VectorStoreAligned(value, current + i);
+
+			// Only watched lanes that actually moved are reported, so lanes at a limit cost nothing
+			if (anyWatched)
+				AddChangedLanes(statType, i, before, value, changedLanes);
+		}
+	}
+}
@@ -0,0 +1,190 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Datatables/SpecIds.h"
+#include "StatTypes.h"
+
+struct FStatIdTag {};
+struct FStatModifierIdTag {};
+
+// Interned stat type, its value is the index of the type's columns in FStatStore
+using FStatId = TSpecId<FStatIdTag>;
+
+// Handle for removing a modifier before it expires
+using FStatModifierId = TSpecId<FStatModifierIdTag>;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnStatChanged, const FStatChange&);
+
+/**
+ * Central storage for every stat value, one column set per stat type with one lane per owner slot.
+ * Touching the same stat across many characters walks one contiguous float array instead of
+ * chasing a UObject per stat. Columns are 16 byte aligned and padded to a multiple of 4 lanes,
+ * so batch clamping and regeneration run 4 lanes at a time with no scalar tail.
+ * Unused lanes are all zeros and pass through the batch operations unchanged.
+ *
+ * The min, max and rate columns always hold effective values. Lanes with modifiers keep their
+ * base values beside the modifier stack and are recomputed only when a modifier is added, removed
+ * or expires, so reading them never walks modifiers.
+ * UStatSubsystem drives time, expiring modifiers and regenerating once per frame.
+ *
+ * Watched lanes are marked dirty as they change, and UStatSubsystem delivers one FStatChange per
+ * changed lane at the end of the frame, so repeated hits in a frame notify once.
+ * Game thread only.
+ */
+class SURVIVALGAME_API FStatStore
+{
+public:
+	// Built in types, interned first so they are compile time constants
+	static const FStatId Health;
+
+	// Fraction of max that FStatChange's becameLow and recovered are measured against
+	static constexpr float LowFraction = 0.25f;
+
+	static FStatStore& Get();
+
+	// Interning is a name hash, do it once and keep the id rather than looking stats up by name
+	FStatId FindOrAddType(FName typeName);
+	FStatId FindType(FName typeName) const;
+	FName GetTypeName(FStatId statType) const { return typeNames[statType.value]; }
+	int32 GetNumTypes() const { return columns.Num(); }
+
+	// One slot per stat owner, shared by all of its stat types
+	int32 AllocateSlot();
+	void ReleaseSlot(int32 slot);
+	int32 GetSlotCapacity() const { return slotCapacity; }
+
+	bool Has(FStatId statType, int32 slot) const { return columns[statType.value].present[slot]; }
+	// Resets the lane, dropping any modifiers on it
+	void Add(FStatId statType, int32 slot, float currentValue, float minValue, float maxValue);
+	void Remove(FStatId statType, int32 slot);
+
+	float GetCurrent(FStatId statType, int32 slot) const { return columns[statType.value].current[slot]; }
+	float GetMin(FStatId statType, int32 slot) const { return columns[statType.value].minimum[slot]; }
+	float GetMax(FStatId statType, int32 slot) const { return columns[statType.value].maximum[slot]; }
+	float GetRate(FStatId statType, int32 slot) const { return columns[statType.value].rate[slot]; }
+
+	// Clamped to [min, max] like UStat always has been
+	void SetCurrent(FStatId statType, int32 slot, float val);
+
+	// These set base values, a lane with modifiers reapplies them on top
+	void SetMin(FStatId statType, int32 slot, float val) { SetBase(statType, slot, EStatModifierTarget::MIN, val); }
+	void SetMax(FStatId statType, int32 slot, float val) { SetBase(statType, slot, EStatModifierTarget::MAX, val); }
+
+	// Change per second applied by Regenerate, negative for decay
+	void SetRate(FStatId statType, int32 slot, float val) { SetBase(statType, slot, EStatModifierTarget::RATE, val); }
+
+	float GetBase(FStatId statType, int32 slot, EStatModifierTarget target) const;
+
+	// duration of zero or less never expires
+	FStatModifierId AddModifier(FStatId statType, int32 slot, EStatModifierTarget target, EStatModifierOp op, float value, float duration = 0);
+	void RemoveModifier(FStatModifierId modifierID);
+
+	// Advances the modifier clock and removes every modifier that has run out
+	void ExpireModifiers(float deltaTime);
+
+	// Removing a lane drops its listeners
+	FDelegateHandle Watch(FStatId statType, int32 slot, const FOnStatChanged::FDelegate& listener);
+	void Unwatch(FStatId statType, int32 slot, FDelegateHandle handle);
+
+	// Notifies the listeners of every watched lane whose value changed since the last delivery
+	void DeliverChanges();
+
+	// Pulls every current value of statType back inside its limits
+	void Clamp(FStatId statType);
+	void ClampAll();
+
+	// Lanes per ParallelFor task, a multiple of 4
+	static const int32 LanesPerTask = 4096;
+
+	// current += rate * deltaTime, then clamped, for every stat of every type.
+	// Runs one task per LanesPerTask slots when parallel, each covering every type for its slots
+	void Regenerate(float deltaTime, bool parallel = false);
+
+private:
+	FStatStore();
+
+	typedef TArray<float, TAlignedHeapAllocator<16>> FStatLanes;
+
+	struct FStatColumn
+	{
+		FStatLanes current;
+		FStatLanes minimum;
+		FStatLanes maximum;
+		FStatLanes rate;
+		TBitArray<> present;
+		// Lanes with an entry in watches, so batch passes can report changes without a map lookup per lane
+		TBitArray<> watched;
+	};
+
+	TArray<FStatColumn> columns;
+	TArray<FName> typeNames;
+	TMap<FName, FStatId> typesByName;
+
+	TArray<int32> freeSlots;
+	int32 usedSlots = 0;
+	int32 slotCapacity = 0;
+
+	struct FStatModifier
+	{
+		FStatModifierId id;
+		EStatModifierTarget target;
+		EStatModifierOp op;
+		float value;
+	};
+
+	struct FStatModifierStack
+	{
+		// Indexed by EStatModifierTarget
+		float baseValues[3];
+		TArray<FStatModifier> modifiers;
+	};
+
+	struct FStatLane
+	{
+		FStatId statType;
+		int32 slot;
+	};
+
+	// Only lanes that have modifiers, keyed by MakeLaneKey
+	TMap<uint64, FStatModifierStack> modifierStacks;
+	TMap<FStatModifierId, FStatLane> modifierLanes;
+	int32 nextModifierID = 0;
+
+	typedef TPair<double, FStatModifierId> FStatExpiry;
+
+	// Min heap of (expiry time, modifier), removed modifiers are skipped when they reach the top
+	TArray<FStatExpiry> expiries;
+	double clock = 0;
+
+	struct FStatWatch
+	{
+		FStatId statType;
+		int32 slot;
+		float lastValue;
+		bool dirty;
+		FOnStatChanged listeners;
+	};
+
+	// Only lanes that have listeners, keyed by MakeLaneKey
+	TMap<uint64, FStatWatch> watches;
+	TArray<uint64> dirtyLanes;
+
+	static bool ExpiresEarlier(const FStatExpiry& a, const FStatExpiry& b) { return a.Key < b.Key; }
+
+	static uint64 MakeLaneKey(FStatId statType, int32 slot) { return ((uint64)(uint32)statType.value << 32) | (uint32)slot; }
+	float& GetEffective(FStatId statType, int32 slot, EStatModifierTarget target);
+	void MarkDirty(uint64 laneKey);
+
+	void SetBase(FStatId statType, int32 slot, EStatModifierTarget target, float val);
+	void Recompute(FStatId statType, int32 slot, const FStatModifierStack& stack);
+	void RemoveModifiers(FStatId statType, int32 slot);
+
+	void ResizeColumn(FStatColumn& column);
+	// Both add the watched lanes they changed to changedLanes, which is only read on the game thread
+	void RegenerateLanes(int32 first, int32 num, float deltaTime, TArray<uint64>& changedLanes);
+	void ClampLanes(FStatId statType, int32 first, int32 num, TArray<uint64>& changedLanes);
+	static VectorRegister ClampValue(const VectorRegister& value, const float* minimum, const float* maximum);
+	void AddChangedLanes(int32 statType, int32 first, const VectorRegister& before, const VectorRegister& after, TArray<uint64>& changedLanes) const;
+};
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StatSubsystem.h"
+#include "StatStore.h"
+#include "DamageQueue.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+
+UStatSubsystem* UStatSubsystem::DRIVER = nullptr;
+
+void UStatSubsystem::Deinitialize()
+{
+	// Let the next subsystem to tick take over the store
+	if (DRIVER == this) {
+		DRIVER = nullptr;
+	}
+
+	Super::Deinitialize();
+}
+
+void UStatSubsystem::Tick(float DeltaTime)
+{
+	if (DRIVER == nullptr) {
+		DRIVER = this;
+	}
+
+	// The frame's hits first, so their health changes are in this frame's notifications
+	FDamageQueue::Get().Resolve(parallel);
+
+	FStatStore& store = FStatStore::Get();
+	UWorld* world = GetGameInstance()->GetWorld();
+
+	if (world != nullptr && !world->IsPaused()) {
+		store.ExpireModifiers(DeltaTime);
+		store.Regenerate(DeltaTime, parallel);
+	}
+
+	// Tickable objects run after the world's tick groups, so this is after all of the frame's changes
+	store.DeliverChanges();
+}
+
+bool UStatSubsystem::IsTickable() const
+{
+	// The class default object is tickable too, only the instance owned by a game instance should run
+	if (HasAnyFlags(RF_ClassDefaultObject)) {
+		return false;
+	}
+
+	// Every game instance has a subsystem but the store is shared, so only one of them runs it
+	return DRIVER == nullptr || DRIVER == this;
+}
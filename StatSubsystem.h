@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "StatSubsystem.generated.h"
+
+/**
+ * Ticks every stat in FStatStore once per frame: modifiers expire, then rates are applied and clamped
+ * in one batched pass over the columns. Characters don't tick their own stats, so the cost follows
+ * the number of stat lanes rather than the number of actors.
+ * Queued damage is resolved before anything else.
+ * Stat change notifications for the frame are delivered last, and still are while the world is paused.
+ * The store and the damage queue are process wide, so with several game instances (PIE with multiple
+ * clients) only one subsystem drives them; another takes over when it is deinitialized.
+ */
+UCLASS()
+class SURVIVALGAME_API UStatSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual bool IsTickableWhenPaused() const override { return true; }
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UStatSubsystem, STATGROUP_Tickables); }
+
+	UFUNCTION(BlueprintCallable, Category = "Stat")
+		bool GetParallel() const { return parallel; }
+
+	UFUNCTION(BlueprintCallable, Category = "Stat")
+		void SetParallel(bool val) { parallel = val; }
+
+private:
+	// The subsystem that ticks the shared store, claimed by the first one to tick
+	static UStatSubsystem* DRIVER;
+
+	// Splits regeneration across the task graph, worth it once there are several thousand slots
+	UPROPERTY(EditAnywhere, Category = "Stat")
+		bool parallel = true;
+};
@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "StatTypes.generated.h"
+
+// Which stored value of a stat a modifier changes
+UENUM(BlueprintType)
+enum class EStatModifierTarget : uint8 {
+	MAX,
+	MIN,
+	RATE
+};
+
+/**
+ * Layers are applied as (base + sum of FLAT) * (1 + sum of PERCENT).
+ * PERCENT values are fractions, 0.25 is +25%. An OVERRIDE replaces the result, the newest one wins.
+ */
+UENUM(BlueprintType)
+enum class EStatModifierOp : uint8 {
+	FLAT,
+	PERCENT,
+	OVERRIDE
+};
+
+// One stat's change over a frame, however many times it was set
+USTRUCT(BlueprintType)
+struct FStatChange
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stat")
+		float oldValue = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stat")
+		float newValue = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Stat")
+		float maxValue = 0;
+
+	// Went from above zero to zero or below
+	UPROPERTY(BlueprintReadOnly, Category = "Stat")
+		bool depleted = false;
+
+	// Went from zero or below back above zero
+	UPROPERTY(BlueprintReadOnly, Category = "Stat")
+		bool restored = false;
+
+	// Fell below FStatStore::LowFraction of max
+	UPROPERTY(BlueprintReadOnly, Category = "Stat")
+		bool becameLow = false;
+
+	// Rose back to FStatStore::LowFraction of max or above
+	UPROPERTY(BlueprintReadOnly, Category = "Stat")
+		bool recovered = false;
+};
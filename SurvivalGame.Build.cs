@@ -1,5 +1,6 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 
+using System.IO;
 using UnrealBuildTool;
 
 public class SurvivalGame : ModuleRules
@@ -10,5 +11,14 @@ public class SurvivalGame : ModuleRules
 
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "UMG" });
         PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
+
+		// The spec pack is opened with a file mapping, so it has to be staged loose rather than inside the pak.
+		// Bake it with -run=BakeSpecPack before building the server
+		string specPackPath = Path.Combine(ModuleDirectory, "..", "..", "Content", "Datatables", "SpecPack.bin");
+
+		if (Target.Type == TargetType.Server && File.Exists(specPackPath))
+		{
+			RuntimeDependencies.Add("$(ProjectDir)/Content/Datatables/SpecPack.bin", StagedFileType.NonUFS);
+		}
     }
 }
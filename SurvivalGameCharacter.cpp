@@ -12,10 +12,12 @@
 #include "MotionControllerComponent.h"
 #include "XRMotionControllerBase.h" // for FXRMotionControllerBase::RightHandSourceId
 #include "Stat.h"
+#include "StatStore.h"
 #include "Items/Weapon.h"
 #include "Items/Armour/Armour.h"
 #include "Datatables/DataTables.h"
 #include "Items/ItemContainer.h"
+#include "Save/WorldSave.h"
 #include "Engine.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogFPChar, Warning, All);
@@ -97,6 +99,21 @@ void ASurvivalGameCharacter::BeginPlay()
 	// Call the base class  
 	Super::BeginPlay();
 
+	// Stats set in the editor go through AddStat so they are bound to this character's slot and indexed
+	TArray<UStat*> editorStats = MoveTemp(stats);
+
+	for (UStat* stat : editorStats) {
+		if (stat != nullptr)
+			AddStat(stat);
+	}
+
+	// Saved state is authoritative, so only the server restores and saves it. Only actors placed in the level
+	// have a path that's the same every session, spawned NPCs and player pawns would be restored onto the wrong character
+	if (HasAuthority() && IsNetStartupActor()) {
+		saveKey = UWorldSave::MakeKey(this);
+		UWorldSave::GetInstance()->RegisterCharacter(this, saveKey);
+	}
+
 	//Attach gun mesh component to Skeleton, doing it here because the skeleton is not yet created in the constructor
 	GetFPGun()->AttachToComponent(Mesh1P, FAttachmentTransformRules(EAttachmentRule::SnapToTarget, true), TEXT("GripPoint"));
 
@@ -118,9 +135,17 @@ void ASurvivalGameCharacter::BeginPlay()
 
 
 void ASurvivalGameCharacter::SetupWithLoadout(int32 loadoutID) {
-	FLoadout* ourloadout = nullptr;
+	UDataTables* dataTables = UDataTables::GetInstance();
+
+	// Come back once the tables are indexed rather than blocking the game thread on them
+	if (!dataTables->IsReady()) {
+		dataTables->WhenReady(FSimpleDelegate::CreateUObject(this, &ASurvivalGameCharacter::SetupWithLoadout, loadoutID));
+		return;
+	}
+
+	const FLoadout* ourloadout = nullptr;
 
-	for (FLoadout* loadout : UDataTables::GetInstance()->GetLoadouts()) {
+	for (const FLoadout* loadout : UDataTables::GetSpecs()->GetLoadouts()) {
 		if (loadout->characterID == this->ID) {
 			ourloadout = loadout;
 			break;
@@ -130,23 +155,40 @@ void ASurvivalGameCharacter::SetupWithLoadout(int32 loadoutID) {
 	if (ourloadout != nullptr) {
 		SetMaxHealth(ourloadout->maxHealth);
 
-		for (TPair<EPosition, int32>& weaponPosition : ourloadout->equippedWeapons) {
+		// Weapons first, then armour, all loaded in one batch
+		TArray<int32> itemIDs;
+		itemIDs.Reserve(ourloadout->equippedWeapons.Num() + ourloadout->equippedArmour.Num());
+
+		for (const TPair<EPosition, int32>& weaponPosition : ourloadout->equippedWeapons) {
+			itemIDs.Add(weaponPosition.Value);
+		}
+		itemIDs.Append(ourloadout->equippedArmour);
+
+		TArray<UItem*> loadedItems = UItemContainer::LoadItems(itemIDs);
+		int32 itemIndex = 0;
+
+		for (const TPair<EPosition, int32>& weaponPosition : ourloadout->equippedWeapons) {
 			TPair<EPosition, UWeapon*> weaponPair;
 			weaponPair.Key = weaponPosition.Key;
-			weaponPair.Value = Cast<UWeapon>(UItemContainer::LoadItem(weaponPosition.Value));
+			weaponPair.Value = Cast<UWeapon>(loadedItems[itemIndex]);
 
-			EquipWeapon(weaponPair);
-		}
+			if (weaponPair.Value != nullptr)
+				EquipWeapon(weaponPair);
+			else
+				UItem::ReleaseItem(loadedItems[itemIndex]);
 
-		for (int32 armourID : ourloadout->equippedArmour) {
-			UArmour* armourFound = Cast<UArmour>(UItemContainer::LoadItem(armourID));
+			itemIndex++;
+		}
 
-			if (armourFound != nullptr) {
-				TPair<EPosition, UArmour*> armourPair;
-				armourPair.Key = armourFound->GetArmourSpecification()->armourPosition;
-				armourPair.Value = armourFound;
+		for (; itemIndex < loadedItems.Num(); itemIndex++) {
+			UArmour* armourFound = Cast<UArmour>(loadedItems[itemIndex]);
 
-				GetArmour().Add(armourPair);
+			if (armourFound != nullptr && armourFound->GetArmourSpecification() != nullptr) {
+				EquipArmour(armourFound);
+			}
+			else {
+				// Loaded but not the armour the loadout expects, nothing holds it
+				UItem::ReleaseItem(loadedItems[itemIndex]);
 			}
 		}
 
@@ -437,10 +479,24 @@ void ASurvivalGameCharacter::EquipWeapon(TPair<EPosition, UWeapon*> weaponPair)
 	EPosition weaponPosition = weaponPair.Key;
 	UWeapon* weapon = weaponPair.Value;
 
+	// Unequipping releases to the pool, so a weapon that's already equipped must not go through it
+	const EPosition* equippedPosition = equipedWeapons.FindKey(weapon);
+	bool moving = false;
+	EPosition previousPosition = weaponPosition;
+
+	if (weapon != nullptr && equippedPosition != nullptr) {
+		if (*equippedPosition == weaponPosition)
+			return;
+
+		moving = true;
+		previousPosition = *equippedPosition;
+		equipedWeapons.Remove(previousPosition);
+	}
+
 	bool couldUnequip = true;
 
 	// Check if we're already equipping something in the same position
-	if (GetWeapons().Find(weaponPosition) != nullptr) {
+	if (equipedWeapons.Contains(weaponPosition)) {
 		couldUnequip = UnEquipWeapon(weaponPosition);
 	}
 	else {
@@ -459,16 +515,20 @@ void ASurvivalGameCharacter::EquipWeapon(TPair<EPosition, UWeapon*> weaponPair)
 		//GetFPMuzzleLocation()->SetRelativeLocation(relativeMuzzleLocation[gunNumber]);
 		AddWeaponPair(weaponPair);
 	}
+	else if (moving) {
+		equipedWeapons.Add(previousPosition, weapon);
+	}
 }
 
 void ASurvivalGameCharacter::AddWeaponPair(TPair<EPosition, UWeapon*> weaponPair)
 {
-	GetWeapons().Add(weaponPair);
+	equipedWeapons.Add(weaponPair.Key, weaponPair.Value);
+	MarkSaveDirty();
 }
 
 bool ASurvivalGameCharacter::UnEquipWeapon(EPosition weaponPosition)
 {
-	UWeapon* weapon = *GetWeapons().Find(weaponPosition);
+	UWeapon* weapon = equipedWeapons.FindRef(weaponPosition);
 
 	if (weapon != nullptr) {
 		if (weapon->CanSwap()) {
@@ -480,41 +540,114 @@ bool ASurvivalGameCharacter::UnEquipWeapon(EPosition weaponPosition)
 		}
 	}
 
+	// Nothing else holds an unequipped weapon, so it goes back to the pool
+	if (equipedWeapons.Remove(weaponPosition) > 0)
+		MarkSaveDirty();
+
+	UItem::ReleaseItem(weapon);
 	return true;
 }
 
 UStat* ASurvivalGameCharacter::GetStatByName(FText statName)
 {
-	for (UStat* stat : stats) {
-		if (stat->GetStatName().EqualTo(statName))
-			return stat;
-	}
-	return NewObject<UStat>();
+	FStatId statType = FStatStore::Get().FindType(FName(*statName.ToString()));
+	return statType.IsValid() ? FindStat(statType) : nullptr;
 }
 
-void ASurvivalGameCharacter::ChangeHealth(float healthChange, bool heals)
+void ASurvivalGameCharacter::ChangeHealth(float healthChange, bool heals, EArmourType damageType)
 {
-	// Need to add in armour damage reduction
 	float healthChangeAmout;
 
 	if (!heals) {
-		healthChangeAmout = -healthChange;
+		healthChangeAmout = -healthChange * GetDamageMultiplier(damageType);
 	}
 	else {
 		healthChangeAmout = healthChange;
 	}
 
-	SetCurrentHealth(GetCurrentHealth() - healthChangeAmout);
+	SetCurrentHealth(GetCurrentHealth() + healthChangeAmout);
+}
+
+void ASurvivalGameCharacter::ApplyDamage(const FVector4& damageByType)
+{
+	UpdateResistances();
+
+	// One 4 wide multiply and sum across every damage type
+	VectorRegister damage = VectorDot4(VectorLoad(&damageByType.X), VectorLoad(damageMultipliers));
+	SetCurrentHealth(GetCurrentHealth() - VectorGetComponent(damage, 0));
+}
+
+float ASurvivalGameCharacter::GetDamageMultiplier(EArmourType damageType)
+{
+	UpdateResistances();
+	return damageMultipliers[(uint8)damageType];
+}
+
+void ASurvivalGameCharacter::EquipArmour(UArmour* newArmour)
+{
+	if (newArmour == nullptr || newArmour->GetArmourSpecification() == nullptr)
+		return;
+
+	EPosition armourPosition = newArmour->GetArmourSpecification()->armourPosition;
+	UArmour* replaced = armour.FindRef(armourPosition);
+
+	armour.Add(armourPosition, newArmour);
+	resistancesDirty = true;
+	MarkSaveDirty();
+
+	// The piece it replaces isn't handed back to anyone, so it goes back to the pool
+	if (replaced != newArmour)
+		UItem::ReleaseItem(replaced);
+}
+
+UArmour* ASurvivalGameCharacter::UnEquipArmour(EPosition armourPosition)
+{
+	UArmour* removed = nullptr;
+
+	if (armour.RemoveAndCopyValue(armourPosition, removed)) {
+		resistancesDirty = true;
+		MarkSaveDirty();
+	}
+
+	return removed;
+}
+
+void ASurvivalGameCharacter::UpdateResistances()
+{
+	uint32 generation = UDataTables::GetSpecs()->GetGeneration();
+
+	if (!resistancesDirty && resistanceGeneration == generation)
+		return;
+
+	float armourTotals[4] = { 0, 0, 0, 0 };
+
+	for (const TPair<EPosition, UArmour*>& armourPair : armour) {
+		if (armourPair.Value == nullptr)
+			continue;
+
+		for (const FArmourValue* armourValue : armourPair.Value->GetArmourValues()) {
+			armourTotals[(uint8)armourValue->armourType] += armourValue->armourValue;
+		}
+	}
+
+	// Each point of armour adds 1% effective health, so stacking armour never reaches full immunity
+	for (int32 i = 0; i < 4; i++) {
+		damageMultipliers[i] = 100 / (100 + FMath::Max(armourTotals[i], 0.0f));
+	}
+
+	resistancesDirty = false;
+	resistanceGeneration = generation;
 }
 
 float ASurvivalGameCharacter::GetCurrentHealth()
 {
-	return GetHealthStat()->GetCurrentValue();
+	// Lanes the character has no stat in hold zero, so this needs no presence check
+	return statSlot != INDEX_NONE ? FStatStore::Get().GetCurrent(FStatStore::Health, statSlot) : 0;
 }
 
 UStat* ASurvivalGameCharacter::GetHealthStat()
 {
-	return GetStatByName(ASurvivalGameCharacter::healthStatName);
+	return FindStat(FStatStore::Health);
 }
 
 FText ASurvivalGameCharacter::GetTextFromLiteral(FName text)
@@ -524,17 +657,33 @@ FText ASurvivalGameCharacter::GetTextFromLiteral(FName text)
 
 void ASurvivalGameCharacter::SetCurrentHealth(float val)
 {
-	GetHealthStat()->SetCurrentValue(val);
+	FStatStore& store = FStatStore::Get();
+
+	if (statSlot != INDEX_NONE && store.Has(FStatStore::Health, statSlot)) {
+		store.SetCurrent(FStatStore::Health, statSlot, val);
+		MarkSaveDirty();
+	}
 }
 
 float ASurvivalGameCharacter::GetMaxHealth()
 {
-	return GetHealthStat()->GetMaxValue();
+	return statSlot != INDEX_NONE ? FStatStore::Get().GetMax(FStatStore::Health, statSlot) : 0;
 }
 
 void ASurvivalGameCharacter::SetMaxHealth(float val)
 {
-	GetHealthStat()->SetMaxValue(val);
+	FStatStore& store = FStatStore::Get();
+
+	if (statSlot != INDEX_NONE && store.Has(FStatStore::Health, statSlot)) {
+		store.SetMax(FStatStore::Health, statSlot, val);
+		MarkSaveDirty();
+	}
+}
+
+void ASurvivalGameCharacter::MarkSaveDirty()
+{
+	if (saveKey != 0)
+		UWorldSave::GetInstance()->MarkCharacterDirty(saveKey);
 }
 
 void ASurvivalGameCharacter::MaximiseStats()
@@ -544,8 +693,57 @@ void ASurvivalGameCharacter::MaximiseStats()
 
 void ASurvivalGameCharacter::AddStat(UStat* newStat)
 {
-	if (GetStatByName(newStat->GetStatName()) == NULL)
-		GetStats().Add(newStat);
+	// Stats that were never created through CreateStat, e.g. set in the editor, are typed by name here
+	FStatId statType = newStat->GetStatType().IsValid() ? newStat->GetStatType() : FStatStore::Get().FindOrAddType(FName(*newStat->GetStatName().ToString()));
+
+	if (FindStat(statType) != nullptr)
+		return;
+
+	newStat->BindToSlot(GetStatSlot());
+	GetStats().Add(newStat);
+
+	if (statsByType.Num() <= statType.value)
+		statsByType.SetNumZeroed(statType.value + 1);
+
+	statsByType[statType.value] = newStat;
+}
+
+int32 ASurvivalGameCharacter::GetStatSlot()
+{
+	if (statSlot == INDEX_NONE)
+		statSlot = FStatStore::Get().AllocateSlot();
+
+	return statSlot;
+}
+
+void ASurvivalGameCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Released here rather than at GC, which can run long after the slot has been handed out again
+	ReleaseStatSlot();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASurvivalGameCharacter::BeginDestroy()
+{
+	// Characters that never played, the stats are unreachable with it but not freed before every BeginDestroy has run
+	ReleaseStatSlot();
+
+	Super::BeginDestroy();
+}
+
+void ASurvivalGameCharacter::ReleaseStatSlot()
+{
+	if (statSlot == INDEX_NONE)
+		return;
+
+	for (UStat* stat : stats) {
+		if (stat != nullptr)
+			stat->Unbind();
+	}
+
+	FStatStore::Get().ReleaseSlot(statSlot);
+	statSlot = INDEX_NONE;
 }
 
 bool ASurvivalGameCharacter::IsAlive()
@@ -556,13 +754,15 @@ bool ASurvivalGameCharacter::IsAlive()
 void ASurvivalGameCharacter::InteractWithTarget(ASurvivalGameCharacter* target)
 {
 	// Assumed Enemy for now. Need to implement friend foe system
+	// Hits land at the end of the frame, so a target can pass this check after an earlier hit this frame
+	// has already killed it. FDamageQueue drops hits on targets that die before they are applied.
 	if (CanAttack() && IsAlive() && target->IsAlive()) {
 		TArray<UWeapon*> weapons;
 
 		equipedWeapons.GenerateValueArray(weapons);
 
 		for (UWeapon* weapon : weapons) {
-			weapon->AttackTarget(target);
+			weapon->AttackTarget(target, this);
 		}
 	}
 }
@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "Datatables/DataTables.h"
+#include "StatStore.h"
 #include "SurvivalGameCharacter.generated.h"
 
 class UInputComponent;
@@ -74,12 +75,34 @@ private:
 	UPROPERTY(EditAnywhere, Category = "Name")
 		TArray<UStat*> stats;
 
+	// This character's lane in every FStatStore column, allocated on first use
+	int32 statSlot = INDEX_NONE;
+
+	// Indexed by FStatId, nullptr for types this character doesn't have
+	TArray<UStat*> statsByType;
+
 	UPROPERTY(EditAnywhere, Category = "Weapon")
 		TMap<EPosition, UWeapon*> equipedWeapons;
 
 	UPROPERTY(EditAnywhere, Category = "Armour")
 		TMap<EPosition, UArmour*> armour;
 
+	// Damage is multiplied by the lane for its EArmourType, rebuilt only when armour changes or the spec tables are swapped
+	float damageMultipliers[4];
+	bool resistancesDirty = true;
+	uint32 resistanceGeneration = 0;
+
+	void UpdateResistances();
+
+	// Unbinds every stat, then gives the slot back so nothing can touch its lanes once it's reused
+	void ReleaseStatSlot();
+
+	// UWorldSave key, 0 until this character is registered for saving
+	uint64 saveKey = 0;
+
+	// Tells UWorldSave this character's saved state is out of date
+	void MarkSaveDirty();
+
 	UPROPERTY(EditAnywhere, Category = "Name")
 		FText characterName;
 
@@ -100,6 +123,10 @@ public:
 	ASurvivalGameCharacter();
 
 	virtual void BeginPlay();
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void BeginDestroy() override;
+
+	int32 GetStatSlot();
 	void InteractWithTarget(ASurvivalGameCharacter* target);
 
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
@@ -171,27 +198,50 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Stats")
 		TArray<UStat*>& GetStats() { return stats; }
 
+	// nullptr when the character has no stat by that name, prefer FindStat with a kept FStatId
 	UFUNCTION(BlueprintCallable, Category = "Stats")
 		UStat* GetStatByName(FText statName);
 
+	UStat* FindStat(FStatId statType) { return statsByType.IsValidIndex(statType.value) ? statsByType[statType.value] : nullptr; }
+
 	UFUNCTION(BlueprintCallable, Category = "Name")
 		FText GetCharacterName() { return characterName; }
 
 	UFUNCTION(BlueprintCallable, Category = "Name")
 		void SetCharacterName(FText val) { characterName = val; }
 
+	// Equipped weapons and armour belong to the character. Unequipping, replacing or restoring them from a save
+	// releases them to UItemPool, so don't keep what these return past that
 	UFUNCTION(BlueprintCallable, Category = "Weapon")
 		TMap<EPosition, UWeapon*> GetWeapons() { return equipedWeapons; }
 
 	UFUNCTION(BlueprintCallable, Category = "Weapon")
 		void SetWeapons(TMap<EPosition, UWeapon*> val) { equipedWeapons = val; }
 
+	// Change armour through EquipArmour, UnEquipArmour or SetArmour so resistances are kept up to date
 	UFUNCTION(BlueprintCallable, Category = "Armour")
-		TMap<EPosition, UArmour*>& GetArmour() { return armour; }
+		const TMap<EPosition, UArmour*>& GetArmour() { return armour; }
 
 	UFUNCTION(BlueprintCallable, Category = "Armour")
-		void SetArmour(TMap<EPosition, UArmour*> val) { armour = val; }
-	void ChangeHealth(float healthChange, bool heals);
+		void SetArmour(TMap<EPosition, UArmour*> val) { armour = val; resistancesDirty = true; }
+
+	// Replaces whatever is in the armour's position, the replaced piece is released to UItemPool
+	UFUNCTION(BlueprintCallable, Category = "Armour")
+		void EquipArmour(UArmour* newArmour);
+
+	// The removed piece is the caller's now, release it with UItem::ReleaseItem once it's dropped
+	UFUNCTION(BlueprintCallable, Category = "Armour")
+		UArmour* UnEquipArmour(EPosition armourPosition);
+
+	// Fraction of damage of this type that gets through armour
+	UFUNCTION(BlueprintCallable, Category = "Armour")
+		float GetDamageMultiplier(EArmourType damageType);
+
+	// Damage is reduced by armour of damageType, healing is not
+	void ChangeHealth(float healthChange, bool heals, EArmourType damageType = EArmourType::PHYSICAL);
+
+	// Mixed damage with one amount per EArmourType lane, e.g. an explosion that is part blast and part physical
+	void ApplyDamage(const FVector4& damageByType);
 
 	//*****************Gun Mesh Arrays********************//
 	//**These are used for changing the gun skeleton and positioning during gameplay**//
@@ -4,6 +4,7 @@
 #include "SurvivalGameHUD.h"
 #include "SurvivalGameCharacter.h"
 #include "UObject/ConstructorHelpers.h"
+#include "Datatables/DataTables.h"
 
 ASurvivalGameGameMode::ASurvivalGameGameMode()
 	: Super()
@@ -15,3 +16,11 @@ ASurvivalGameGameMode::ASurvivalGameGameMode()
 	// use our custom HUD class
 	HUDClass = ASurvivalGameHUD::StaticClass();
 }
+
+void ASurvivalGameGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	// Start loading the spec tables in the background so they're indexed before anyone spawns
+	UDataTables::GetInstance()->PreloadAsync();
+}
@@ -13,6 +13,8 @@ class ASurvivalGameGameMode : public AGameModeBase
 
 public:
 	ASurvivalGameGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
 };
 
 